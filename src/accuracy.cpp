@@ -0,0 +1,445 @@
+// Headless accuracy check of the fast illumination and distance paths
+//
+// Companion of the benchmark: every kernel it times is compared here against
+// a double precision reference, so that speedups come with measured error
+// bounds. Distances are checked on random pairs of points, uniform over the
+// globe as well as nearly coincident and nearly antipodal ones, where the
+// formulations differ most. Classifications are checked tile by tile against
+// great circle distances compared with the cutoffs in km, and counted
+// separately at each cutoff.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "distance_kernels.hpp"
+#include "illumination.hpp"
+#include "latlon.hpp"
+#include "quadtree.hpp"
+#include "thread_pool.hpp"
+#include "tile_grid.hpp"
+
+namespace
+{
+    // Same as the benchmark's, followed by random ones
+    const LatLon fixed_suns[] = {
+        LatLon{0.f, 0.f},
+        LatLon{23.44f, 90.f},
+        LatLon{-23.44f, -120.f},
+        LatLon{47.7511f, 120.7401f},
+    };
+
+    // Points compared against each origin in the distance checks
+    const std::size_t targets_per_origin = 4096;
+
+    struct Options
+    {
+        std::vector<float> sizes = {800.f, 1600.f};
+        std::vector<float> steps = {1.f, 2.f};
+        std::size_t pairs = 4000000;
+        std::size_t suns = 16;
+        std::size_t threads = ThreadPool::default_thread_count();
+        // Fail if a distance kernel is off by more than this, unless 0
+        double max_km = 0.;
+        bool csv = false;
+    };
+
+    const auto pi_d = 3.14159265358979323846;
+
+    double deg2rad_d(double deg)
+    {
+        return deg * (pi_d / 180.);
+    }
+
+    double rad2deg_d(double rad)
+    {
+        return rad * (180. / pi_d);
+    }
+
+    // Great circle distance in double precision, the reference for every
+    // check. atan2 keeps it accurate for coincident and antipodal points
+    // alike, where asin and acos lose precision.
+    double reference_distance(const LatLon &a, const LatLon &b)
+    {
+        const auto lat1 = deg2rad_d(a.lat);
+        const auto lat2 = deg2rad_d(b.lat);
+        const auto u = std::sin((lat2 - lat1) / 2.);
+        const auto v = std::sin(deg2rad_d(static_cast<double>(b.lon) - a.lon) / 2.);
+        const auto h = std::min(u * u + std::cos(lat1) * std::cos(lat2) * v * v, 1.);
+        return 2. * earth_radius_km * std::atan2(std::sqrt(h), std::sqrt(1. - h));
+    }
+
+    // Illumination and ShadowRamp level a tile `distance` km from the sun
+    // should have, with the ramp linear in distance as in the shader
+    Illumination reference_class(double distance)
+    {
+        return static_cast<Illumination>((distance >= direct_illumination_cutoff) + (distance > twilight_cutoff));
+    }
+
+    int reference_level(double distance)
+    {
+        const auto ramp = (distance - direct_illumination_cutoff) / (twilight_cutoff - direct_illumination_cutoff);
+        return static_cast<int>(std::lround(std::min(std::max(ramp, 0.), 1.) * 255.));
+    }
+
+    // Uniformly distributed over the sphere
+    LatLon random_point(std::mt19937 &random)
+    {
+        std::uniform_real_distribution<double> unit(-1., 1.);
+        return LatLon{static_cast<float>(rad2deg_d(std::asin(unit(random)))), static_cast<float>(180. * unit(random))};
+    }
+
+    // Point `distance` km from `origin` in a random direction
+    LatLon offset_point(const LatLon &origin, double distance, std::mt19937 &random)
+    {
+        std::uniform_real_distribution<double> turn(0., 2. * pi_d);
+        const auto angle = distance / earth_radius_km;
+        const auto bearing = turn(random);
+        const auto lat = deg2rad_d(origin.lat);
+        const auto lat2 = std::asin(std::sin(lat) * std::cos(angle) + std::cos(lat) * std::sin(angle) * std::cos(bearing));
+        const auto dlon = std::atan2(std::sin(bearing) * std::sin(angle) * std::cos(lat), std::cos(angle) - std::sin(lat) * std::sin(lat2));
+        return LatLon{static_cast<float>(rad2deg_d(lat2)), static_cast<float>(std::remainder(origin.lon + rad2deg_d(dlon), 360.))};
+    }
+
+    // Maximum and mean of absolute errors, along with the samples that are
+    // off at all or, for distances, not even finite
+    struct ErrorStats
+    {
+        double max = 0.;
+        double sum = 0.;
+        std::size_t count = 0;
+        std::size_t mismatches = 0;
+
+        void add(double error)
+        {
+            if (!std::isfinite(error))
+            {
+                ++mismatches;
+                return;
+            }
+            error = std::fabs(error);
+            max = std::max(max, error);
+            sum += error;
+            ++count;
+        }
+
+        double mean() const { return count ? sum / count : 0.; }
+    };
+
+    void print_header(const Options &options)
+    {
+        if (options.csv)
+        {
+            std::printf("check,kernel,case,samples,max_error,mean_error,mismatches\n");
+        }
+        else
+        {
+            std::printf("%-14s %-24s %-10s %10s %12s %12s %10s\n", "check", "kernel", "case", "samples", "max", "mean", "mismatches");
+        }
+    }
+
+    // Rows without errors or mismatches to report leave them out
+    void report(const Options &options, const char *check, const char *kernel, const std::string &test_case, std::size_t samples, const ErrorStats *errors,
+                const std::size_t *mismatches)
+    {
+        char max[32] = "-", mean[32] = "-", count[32] = "-";
+        if (errors)
+        {
+            std::snprintf(max, sizeof(max), "%.6f", errors->max);
+            std::snprintf(mean, sizeof(mean), "%.6f", errors->mean());
+        }
+        if (mismatches)
+        {
+            std::snprintf(count, sizeof(count), "%zu", *mismatches);
+        }
+
+        if (options.csv)
+        {
+            const auto field = [](const char *value) { return value[0] == '-' ? "" : value; };
+            std::printf("%s,%s,%s,%zu,%s,%s,%s\n", check, kernel, test_case.c_str(), samples, field(max), field(mean), field(count));
+        }
+        else
+        {
+            std::printf("%-14s %-24s %-10s %10zu %12s %12s %10s\n", check, kernel, test_case.c_str(), samples, max, mean, count);
+        }
+    }
+
+    // Error of every distance kernel from random origins to targets made from
+    // them by `make_target`, in km. Returns the largest error, infinite if
+    // any result was NaN.
+    template <typename MakeTarget>
+    double check_distances(const Options &options, const char *test_case, std::mt19937 &random, MakeTarget &&make_target)
+    {
+        const auto origins = std::max<std::size_t>(options.pairs / targets_per_origin, 1);
+
+        std::vector<LatLon> targets(targets_per_origin);
+        std::vector<float> lat(targets_per_origin), lon(targets_per_origin);
+        std::vector<double> reference(targets_per_origin);
+        std::vector<float> distances(targets_per_origin);
+        UnitVectorSet row, columns;
+
+        ErrorStats scalar, batch, matrix;
+        for (std::size_t o = 0; o < origins; ++o)
+        {
+            const auto origin = random_point(random);
+            for (std::size_t i = 0; i < targets_per_origin; ++i)
+            {
+                targets[i] = make_target(origin);
+                lat[i] = targets[i].lat;
+                lon[i] = targets[i].lon;
+                reference[i] = reference_distance(origin, targets[i]);
+            }
+
+            for (std::size_t i = 0; i < targets_per_origin; ++i)
+            {
+                scalar.add(origin.spherical_distance(targets[i]) - reference[i]);
+            }
+
+            spherical_distance_batch(origin, lat.data(), lon.data(), distances.data(), targets_per_origin);
+            for (std::size_t i = 0; i < targets_per_origin; ++i)
+            {
+                batch.add(distances[i] - reference[i]);
+            }
+
+            row.assign(&origin, 1);
+            columns.assign(targets.data(), targets_per_origin);
+            distance_matrix(row, columns, distances.data());
+            for (std::size_t i = 0; i < targets_per_origin; ++i)
+            {
+                matrix.add(distances[i] - reference[i]);
+            }
+        }
+
+        // Mismatches are the NaN results
+        const auto samples = origins * targets_per_origin;
+        report(options, "distance_km", "spherical_distance", test_case, samples, &scalar, &scalar.mismatches);
+        report(options, "distance_km", "spherical_distance_batch", test_case, samples, &batch, &batch.mismatches);
+        report(options, "distance_km", "distance_matrix", test_case, samples, &matrix, &matrix.mismatches);
+        if (scalar.mismatches + batch.mismatches + matrix.mismatches > 0)
+        {
+            return HUGE_VAL;
+        }
+        return std::max({scalar.max, batch.max, matrix.max});
+    }
+
+    // Tiles classified differently from the reference, at either cutoff
+    struct ClassMismatches
+    {
+        std::size_t direct = 0;
+        std::size_t twilight = 0;
+
+        void add(Illumination reference, Illumination fast)
+        {
+            direct += (reference == Illumination::Day) != (fast == Illumination::Day);
+            twilight += (reference == Illumination::Night) != (fast == Illumination::Night);
+        }
+    };
+
+    void report_classes(const Options &options, const char *kernel, const std::string &test_case, std::size_t samples, const ClassMismatches &mismatches)
+    {
+        report(options, "class_direct", kernel, test_case, samples, nullptr, &mismatches.direct);
+        report(options, "class_twilight", kernel, test_case, samples, nullptr, &mismatches.twilight);
+    }
+
+    // Every classification path on the grid of `size` and `step` for all `suns`
+    void check_classification(const Options &options, ThreadPool &pool, const std::vector<LatLon> &suns, float size, float step)
+    {
+        TileGrid grid;
+        grid.build(size, step);
+        const auto tiles = grid.count();
+        const auto cutoffs = IlluminationCutoffs::standard();
+        const auto side = quadtree_side(size, step);
+
+        // Distances against the cutoffs, as the viewer did before the dot product
+        const auto classify_distance = [](float distance) {
+            return static_cast<Illumination>((distance >= direct_illumination_cutoff) + (distance > twilight_cutoff));
+        };
+
+        std::vector<Illumination> reference(tiles), illumination(tiles), raster(side * side);
+        std::vector<int> reference_levels(tiles);
+        std::vector<float> distances(tiles);
+        std::vector<std::uint8_t> shade;
+        ClassMismatches scalar, batch, dot, dot_pool, incremental, quadtree;
+        ErrorStats shade_errors;
+        for (const auto &sun : suns)
+        {
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                const auto distance = reference_distance(sun, LatLon{grid.lat[i], grid.lon[i]});
+                reference[i] = reference_class(distance);
+                reference_levels[i] = reference_level(distance);
+            }
+
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                scalar.add(reference[i], classify_distance(sun.spherical_distance(LatLon{grid.lat[i], grid.lon[i]})));
+            }
+
+            spherical_distance_batch(sun, grid.lat.data(), grid.lon.data(), distances.data(), tiles);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                batch.add(reference[i], classify_distance(distances[i]));
+            }
+
+            grid.classify(sun, cutoffs, illumination);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                dot.add(reference[i], illumination[i]);
+            }
+
+            grid.classify(sun, cutoffs, illumination, pool);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                dot_pool.add(reference[i], illumination[i]);
+            }
+
+            // Coming from the sun a quarter of a degree earlier, as in the benchmark
+            IlluminationBuffer buffer;
+            grid.update(LatLon{sun.lat, sun.lon - 0.25f}, cutoffs, buffer, pool);
+            grid.update(sun, cutoffs, buffer, pool);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                incremental.add(reference[i], buffer.tiles[i]);
+            }
+
+            // Same tiles in raster order
+            classify_quadtree(sun, cutoffs, size, step, raster.data(), nullptr, pool);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                const auto tx = static_cast<std::size_t>(std::lround(grid.x[i] / step));
+                const auto ty = static_cast<std::size_t>(std::lround(grid.y[i] / step));
+                quadtree.add(reference[i], raster[ty * side + tx]);
+            }
+
+            grid.shade(sun, cutoffs, shade, pool);
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                shade_errors.add(shade[i] - reference_levels[i]);
+                shade_errors.mismatches += shade[i] != reference_levels[i];
+            }
+        }
+
+        char test_case[32];
+        std::snprintf(test_case, sizeof(test_case), "%g/%g", size, step);
+        const auto samples = tiles * suns.size();
+        report_classes(options, "spherical_distance", test_case, samples, scalar);
+        report_classes(options, "spherical_distance_batch", test_case, samples, batch);
+        report_classes(options, "classify", test_case, samples, dot);
+        report_classes(options, "classify_pool", test_case, samples, dot_pool);
+        report_classes(options, "classify_incremental", test_case, samples, incremental);
+        report_classes(options, "classify_quadtree", test_case, samples, quadtree);
+        report(options, "shade_level", "shade_pool", test_case, samples, &shade_errors, &shade_errors.mismatches);
+    }
+
+    // Comma separated list of numbers
+    std::vector<float> parse_list(const std::string &list)
+    {
+        std::vector<float> values;
+        std::size_t start = 0;
+        while (start <= list.size())
+        {
+            const auto end = std::min(list.find(',', start), list.size());
+            values.push_back(std::strtof(list.substr(start, end - start).c_str(), nullptr));
+            start = end + 1;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc)
+        {
+            options.sizes = parse_list(argv[++i]);
+        }
+        else if (arg == "--steps" && i + 1 < argc)
+        {
+            options.steps = parse_list(argv[++i]);
+        }
+        else if (arg == "--pairs" && i + 1 < argc)
+        {
+            options.pairs = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--suns" && i + 1 < argc)
+        {
+            options.suns = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-km" && i + 1 < argc)
+        {
+            options.max_km = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--csv")
+        {
+            options.csv = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--sizes 800,1600] [--steps 1,2] [--pairs N] [--suns N] [--threads N] [--max-km KM] [--csv]" << std::endl;
+            return 1;
+        }
+    }
+
+    ThreadPool pool(options.threads);
+
+    // Fixed seed, so that runs before and after a change see the same points
+    std::mt19937 random(20240320);
+
+    print_header(options);
+
+    // Pairs closer than 10 m to 10 km apart, and as far from antipodal
+    std::uniform_real_distribution<double> log_distance(std::log(0.01), std::log(10.));
+    auto max_error = check_distances(options, "uniform", random, [&](const LatLon &) { return random_point(random); });
+    max_error = std::max(max_error, check_distances(options, "nearby", random, [&](const LatLon &origin) {
+        return offset_point(origin, std::exp(log_distance(random)), random);
+    }));
+    max_error = std::max(max_error, check_distances(options, "antipodal", random, [&](const LatLon &origin) {
+        const auto antipode = LatLon{-origin.lat, std::remainder(origin.lon + 180.f, 360.f)};
+        return offset_point(antipode, std::exp(log_distance(random)), random);
+    }));
+
+    std::vector<LatLon> suns(std::begin(fixed_suns), std::end(fixed_suns));
+    while (suns.size() < options.suns)
+    {
+        // The sun never leaves the tropics
+        std::uniform_real_distribution<float> lat(-23.44f, 23.44f), lon(-180.f, 180.f);
+        suns.push_back(LatLon{lat(random), lon(random)});
+    }
+    suns.resize(std::min(suns.size(), std::max<std::size_t>(options.suns, 1)));
+
+    for (const auto size : options.sizes)
+    {
+        for (const auto step : options.steps)
+        {
+            check_classification(options, pool, suns, size, step);
+        }
+    }
+
+    // NaN results fail the run as well, they count as an infinite error
+    if (options.max_km > 0. && max_error > options.max_km)
+    {
+        if (std::isinf(max_error))
+        {
+            std::cerr << "Distance kernels returned NaN" << std::endl;
+        }
+        else
+        {
+            std::cerr << "Distance error of " << max_error << " km exceeds " << options.max_km << " km" << std::endl;
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Illumination resolution that follows a time budget
+//
+// Illumination cost grows with the square of the resolution, so after every
+// update the resolution is scaled by the square root of budget over cost.
+// Changes under 20% are ignored and the rest rounded to `granularity`, which
+// keeps the grid from being rebuilt over small timing noise.
+class AdaptiveResolution
+{
+public:
+    AdaptiveResolution(unsigned resolution, unsigned minimum, unsigned granularity = 16)
+        : resolution(resolution), minimum(minimum), granularity(granularity)
+    {
+    }
+
+    unsigned get() const { return resolution; }
+
+    // Take an update that took `cost_ms` against `budget_ms`, capped at `maximum`
+    void update(double cost_ms, double budget_ms, unsigned maximum)
+    {
+        if (cost_ms <= 0. || budget_ms <= 0.)
+        {
+            return;
+        }
+
+        const auto wanted = static_cast<double>(resolution) * std::sqrt(budget_ms / cost_ms);
+        if (std::abs(wanted - resolution) < 0.2 * resolution && resolution <= maximum)
+        {
+            return;
+        }
+
+        const auto rounded = static_cast<unsigned>(std::lround(wanted / granularity)) * granularity;
+        resolution = std::min(std::max(rounded, minimum), std::max(maximum, minimum));
+    }
+
+private:
+    unsigned resolution;
+    unsigned minimum;
+    unsigned granularity;
+};
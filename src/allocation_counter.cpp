@@ -0,0 +1,40 @@
+#include "allocation_counter.hpp"
+
+#ifdef FLAT_EARTH_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<std::size_t> allocations{0};
+}
+
+std::size_t allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms call these by default
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Debug count of heap allocations, for keeping them out of the frame loop
+//
+// Built with FLAT_EARTH_COUNT_ALLOCATIONS, the global operator new is
+// replaced with one that counts every allocation made on any thread.
+// Otherwise nothing is counted and the count stays 0.
+#ifdef FLAT_EARTH_COUNT_ALLOCATIONS
+constexpr bool counting_allocations = true;
+
+std::size_t allocation_count();
+#else
+constexpr bool counting_allocations = false;
+
+inline std::size_t allocation_count()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,394 @@
+// Headless benchmark of the illumination pipeline
+//
+// Sweeps map resolution and tile step over a fixed set of sun positions and
+// reports throughput of every stage the viewer runs on the CPU. No window or
+// map image is needed, so this runs in CI and on servers.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "distance_kernels.hpp"
+#include "illumination.hpp"
+#include "latlon.hpp"
+#include "projection.hpp"
+#include "quadtree.hpp"
+#include "sphere_index.hpp"
+#include "thread_pool.hpp"
+#include "tile_grid.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Equinox and solstice noons over a few meridians, plus the viewer's default
+    const LatLon suns[] = {
+        LatLon{0.f, 0.f},
+        LatLon{23.44f, 90.f},
+        LatLon{-23.44f, -120.f},
+        LatLon{47.7511f, 120.7401f},
+    };
+
+    struct Options
+    {
+        std::vector<float> sizes = {400.f, 800.f, 1600.f, 3200.f};
+        std::vector<float> steps = {1.f, 2.f, 4.f};
+        std::size_t threads = ThreadPool::default_thread_count();
+        // Minimum time spent on each measurement
+        double min_seconds = 0.25;
+        bool csv = false;
+    };
+
+    // Keeps results alive so that the measured loops aren't optimized away
+    volatile float sink;
+
+    // Run `body` until at least `min_seconds` have passed, return seconds per run
+    template <typename Body>
+    double measure(double min_seconds, Body &&body)
+    {
+        body();
+
+        std::size_t runs = 0;
+        const auto start = Clock::now();
+        auto elapsed = 0.;
+        do
+        {
+            body();
+            ++runs;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < min_seconds);
+
+        return elapsed / runs;
+    }
+
+    void report(const Options &options, const char *name, float size, float step, std::size_t tiles, double seconds)
+    {
+        const auto ns_per_tile = seconds * 1e9 / tiles;
+        const auto tiles_per_second = tiles / seconds;
+        if (options.csv)
+        {
+            std::printf("%s,%g,%g,%zu,%.3f,%.0f\n", name, size, step, tiles, ns_per_tile, tiles_per_second);
+        }
+        else
+        {
+            std::printf("%-26s %6g %5g %10zu %10.3f %12.2f\n", name, size, step, tiles, ns_per_tile, tiles_per_second / 1e6);
+        }
+    }
+
+    // Grid construction for the map in `Projection`, which covers more or
+    // less of the square than the default one
+    template <typename Projection>
+    void run_projection(const Options &options, float size, float step)
+    {
+        TileGrid grid;
+        const auto build = measure(options.min_seconds, [&] { grid.build<Projection>(size, step); });
+        report(options, (std::string("grid_build_") + Projection::name()).c_str(), size, step, grid.count(), build);
+    }
+
+    void run(const Options &options, ThreadPool &pool, float size, float step)
+    {
+        TileGrid grid;
+        const auto build = measure(options.min_seconds, [&] { grid.build(size, step); });
+        const auto tiles = grid.count();
+        report(options, "grid_build", size, step, tiles, build);
+        run_projection<Equirectangular>(options, size, step);
+        run_projection<Orthographic>(options, size, step);
+        run_projection<Mercator>(options, size, step);
+
+        // Inverse projection alone, over the tile positions of the grid
+        const auto radius = size / 2.f;
+        const auto projection = measure(options.min_seconds, [&] {
+            auto total = 0.f;
+            for (std::size_t i = 0; i < tiles; ++i)
+            {
+                const auto coords = (Vec2{grid.x[i], grid.y[i]} - Vec2{radius, radius}) / radius;
+                total += LatLon::from_azimuthal_equidistant(coords).lat;
+            }
+            sink = total;
+        });
+        report(options, "from_azimuthal_equidistant", size, step, tiles, projection);
+
+        // Sun-dependent stages, averaged over all sun positions
+        const auto sun_count = sizeof(suns) / sizeof(suns[0]);
+        std::vector<float> distances(tiles);
+        std::vector<Illumination> illumination(tiles);
+
+        const auto reference = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                for (std::size_t i = 0; i < tiles; ++i)
+                {
+                    distances[i] = sun.spherical_distance(LatLon{grid.lat[i], grid.lon[i]});
+                }
+                sink = distances[tiles / 2];
+            }
+        });
+        report(options, "spherical_distance", size, step, tiles, reference / sun_count);
+
+        const auto batch = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                spherical_distance_batch(sun, grid.lat.data(), grid.lon.data(), distances.data(), tiles);
+                sink = distances[tiles / 2];
+            }
+        });
+        report(options, "spherical_distance_batch", size, step, tiles, batch / sun_count);
+
+        const auto cutoffs = IlluminationCutoffs::standard();
+        const auto classify = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                grid.classify(sun, cutoffs, illumination);
+                sink = static_cast<float>(illumination[tiles / 2]);
+            }
+        });
+        report(options, "classify", size, step, tiles, classify / sun_count);
+
+        const auto classify_pool = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                grid.classify(sun, cutoffs, illumination, pool);
+                sink = static_cast<float>(illumination[tiles / 2]);
+            }
+        });
+        report(options, "classify_pool", size, step, tiles, classify_pool / sun_count);
+
+        std::vector<std::uint8_t> shade;
+        const auto shade_pool = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                grid.shade(sun, cutoffs, shade, pool);
+                sink = static_cast<float>(shade[tiles / 2]);
+            }
+        });
+        report(options, "shade_pool", size, step, tiles, shade_pool / sun_count);
+
+        // The sun moving by a quarter of a degree, about a minute of real time
+        IlluminationBuffer buffers[sun_count];
+        auto nudge = 0.f;
+        const auto classify_incremental = measure(options.min_seconds, [&] {
+            nudge = 0.25f - nudge;
+            for (std::size_t i = 0; i < sun_count; ++i)
+            {
+                grid.update(LatLon{suns[i].lat, suns[i].lon + nudge}, cutoffs, buffers[i], pool);
+                sink = static_cast<float>(buffers[i].tiles[tiles / 2]);
+            }
+        });
+        report(options, "classify_incremental", size, step, tiles, classify_incremental / sun_count);
+
+        // Needs no grid, compare against grid_build + classify for a one-off frame
+        std::vector<Illumination> raster(quadtree_side(size, step) * quadtree_side(size, step));
+        const auto quadtree = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                classify_quadtree(sun, cutoffs, size, step, raster.data(), nullptr);
+                sink = static_cast<float>(raster[raster.size() / 2]);
+            }
+        });
+        report(options, "classify_quadtree", size, step, tiles, quadtree / sun_count);
+
+        const auto quadtree_pool = measure(options.min_seconds, [&] {
+            for (const auto &sun : suns)
+            {
+                classify_quadtree(sun, cutoffs, size, step, raster.data(), nullptr, pool);
+                sink = static_cast<float>(raster[raster.size() / 2]);
+            }
+        });
+        report(options, "classify_quadtree_pool", size, step, tiles, quadtree_pool / sun_count);
+    }
+
+    // `count` places along a golden angle spiral, roughly uniform over the globe
+    //
+    // The angle is accumulated in double, in float it would snap to whole
+    // degrees past about 60000 places.
+    std::vector<LatLon> spread_places(std::size_t count)
+    {
+        std::vector<LatLon> places(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto z = 1.f - 2.f * (i + 0.5f) / count;
+            places[i] = LatLon{rad2deg(asinf(z)), static_cast<float>(std::remainder(i * 137.50776, 360.))};
+        }
+        return places;
+    }
+
+    // All pairs among `count` places spread over the globe, reported as size
+    // `count` and step 0 with pairs in place of tiles
+    void run_matrix(const Options &options, ThreadPool &pool, std::size_t count)
+    {
+        const auto places = spread_places(count);
+
+        UnitVectorSet points;
+        const auto prepare = measure(options.min_seconds, [&] { points.assign(places.data(), count); });
+        report(options, "unit_vector_set", count, 0, count, prepare);
+
+        const auto pairs = count * count;
+        std::vector<float> matrix(pairs);
+        const auto single = measure(options.min_seconds, [&] {
+            distance_matrix(points, points, matrix.data());
+            sink = matrix[pairs / 2];
+        });
+        report(options, "distance_matrix", count, 0, pairs, single);
+
+        const auto threaded = measure(options.min_seconds, [&] {
+            distance_matrix(points, points, matrix.data(), pool);
+            sink = matrix[pairs / 2];
+        });
+        report(options, "distance_matrix_pool", count, 0, pairs, threaded);
+    }
+
+    // Place queries against `count` places, reported as size `count` and
+    // step 0 with queries in place of tiles
+    void run_places(const Options &options, std::size_t count)
+    {
+        const auto places = spread_places(count);
+        std::vector<float> lat(count), lon(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            lat[i] = places[i].lat;
+            lon[i] = places[i].lon;
+        }
+
+        SphereIndex index;
+        const auto build = measure(options.min_seconds, [&] { index.build(places.data(), count); });
+        report(options, "sphere_index_build", count, 0, count, build);
+
+        // Query points off the spiral, with the viewer's default sun among them
+        const std::size_t queries = 64;
+        std::vector<LatLon> points = spread_places(queries);
+        for (auto &p : points)
+        {
+            p.lon = std::remainder(p.lon + 1.234f, 360.f);
+        }
+
+        const std::size_t k = 8;
+        const auto radius_km = 500.f;
+        std::vector<float> distances(count);
+        std::vector<std::uint32_t> order(count);
+        const auto brute_nearest = measure(options.min_seconds, [&] {
+            for (const auto &p : points)
+            {
+                spherical_distance_batch(p, lat.data(), lon.data(), distances.data(), count);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    order[i] = static_cast<std::uint32_t>(i);
+                }
+                std::partial_sort(order.begin(), order.begin() + k, order.end(), [&](std::uint32_t a, std::uint32_t b) {
+                    return distances[a] < distances[b];
+                });
+                sink = distances[order[0]];
+            }
+        });
+        report(options, "nearest_brute_force", count, 0, queries, brute_nearest);
+
+        std::vector<SphereIndex::Hit> hits;
+        const auto nearest = measure(options.min_seconds, [&] {
+            for (const auto &p : points)
+            {
+                index.nearest(p, k, hits);
+                sink = hits[0].distance;
+            }
+        });
+        report(options, "sphere_index_nearest", count, 0, queries, nearest);
+
+        const auto brute_within = measure(options.min_seconds, [&] {
+            for (const auto &p : points)
+            {
+                spherical_distance_batch(p, lat.data(), lon.data(), distances.data(), count);
+                std::size_t found = 0;
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    found += distances[i] <= radius_km;
+                }
+                sink = static_cast<float>(found);
+            }
+        });
+        report(options, "within_brute_force", count, 0, queries, brute_within);
+
+        const auto within = measure(options.min_seconds, [&] {
+            for (const auto &p : points)
+            {
+                index.within(p, radius_km, hits);
+                sink = static_cast<float>(hits.size());
+            }
+        });
+        report(options, "sphere_index_within", count, 0, queries, within);
+    }
+
+    // Comma separated list of numbers
+    std::vector<float> parse_list(const std::string &list)
+    {
+        std::vector<float> values;
+        std::size_t start = 0;
+        while (start <= list.size())
+        {
+            const auto end = std::min(list.find(',', start), list.size());
+            values.push_back(std::strtof(list.substr(start, end - start).c_str(), nullptr));
+            start = end + 1;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc)
+        {
+            options.sizes = parse_list(argv[++i]);
+        }
+        else if (arg == "--steps" && i + 1 < argc)
+        {
+            options.steps = parse_list(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--min-time" && i + 1 < argc)
+        {
+            options.min_seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--csv")
+        {
+            options.csv = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--sizes 400,800] [--steps 1,2] [--threads N] [--min-time SECONDS] [--csv]" << std::endl;
+            return 1;
+        }
+    }
+
+    ThreadPool pool(options.threads);
+
+    if (options.csv)
+    {
+        std::printf("benchmark,size,step,tiles,ns_per_tile,tiles_per_second\n");
+    }
+    else
+    {
+        std::printf("%-26s %6s %5s %10s %10s %12s\n", "benchmark", "size", "step", "tiles", "ns/tile", "Mtiles/s");
+    }
+
+    for (const auto size : options.sizes)
+    {
+        for (const auto step : options.steps)
+        {
+            run(options, pool, size, step);
+        }
+    }
+    run_matrix(options, pool, 2000);
+    run_places(options, 100000);
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "distance_kernels.hpp"
+
+#include <algorithm>
+
+#include "simd.hpp"
+
+namespace
+{
+    // sin(x) for x in [-π/2, π/2], Taylor series up to x¹¹
+    template <typename V>
+    V sin_poly(V x)
+    {
+        const auto x2 = x * x;
+        auto p = V::broadcast(-1.f / 39916800.f);
+        p = p * x2 + V::broadcast(1.f / 362880.f);
+        p = p * x2 + V::broadcast(-1.f / 5040.f);
+        p = p * x2 + V::broadcast(1.f / 120.f);
+        p = p * x2 + V::broadcast(-1.f / 6.f);
+        return x + x * x2 * p;
+    }
+
+    // sin²(x) for any x, using its period of π to reduce the argument
+    template <typename V>
+    V sin_squared(V x)
+    {
+        x = x - V::broadcast(pi) * round(x * V::broadcast(1.f / pi));
+        const auto s = sin_poly(x);
+        return s * s;
+    }
+
+    // cos(x) for x in [-π/2, π/2]
+    template <typename V>
+    V cos_poly(V x)
+    {
+        return sin_poly(V::broadcast(pi / 2.f) - abs(x));
+    }
+
+    // asin(√h) for h in [0, 1], after Cephes asinf
+    //
+    // Above √h = 0.5 the identity asin(x) = π/2 - 2 asin(√((1 - x) / 2)) keeps
+    // the polynomial argument small. 1 - x is computed as (1 - h) / (1 + x),
+    // with 1 - h passed in separately so that it keeps its precision for
+    // nearly antipodal points.
+    template <typename V>
+    V asin_sqrt(V h, V one_minus_h)
+    {
+        const auto one = V::broadcast(1.f);
+        const auto half = V::broadcast(0.5f);
+        const auto x = sqrt(h);
+        const auto large = greater(x, half);
+        const auto a = select(large, sqrt(one_minus_h * half / (one + x)), x);
+
+        const auto z = a * a;
+        auto p = V::broadcast(4.2163199048e-2f);
+        p = p * z + V::broadcast(2.4181311049e-2f);
+        p = p * z + V::broadcast(4.5470025998e-2f);
+        p = p * z + V::broadcast(7.4953002686e-2f);
+        p = p * z + V::broadcast(1.6666752422e-1f);
+        const auto r = a + a * z * p;
+
+        return select(large, V::broadcast(pi / 2.f) - r - r, r);
+    }
+
+    template <typename V>
+    void haversine(float lat1r, float lon1r, float cos_lat1, const float *lat, const float *lon, float *out)
+    {
+        const auto to_rad = V::broadcast(pi / 180.f);
+        const auto lat2r = V::load(lat) * to_rad;
+        const auto lon2r = V::load(lon) * to_rad;
+
+        const auto zero = V::broadcast(0.f);
+        const auto one = V::broadcast(1.f);
+        const auto half = V::broadcast(0.5f);
+        const auto half_dlon = (lon2r - V::broadcast(lon1r)) * half;
+        const auto cos_product = V::broadcast(cos_lat1) * cos_poly(lat2r);
+        const auto h = sin_squared((lat2r - V::broadcast(lat1r)) * half) + cos_product * sin_squared(half_dlon);
+
+        // 1 - h is the haversine of the distance to the antipode of the
+        // second point, sin²((lat1 + lat2) / 2) + cos(lat1) cos(lat2)
+        // cos²(Δlon / 2). Both terms are positive, so unlike 1 minus the sum
+        // above it doesn't cancel for nearly antipodal points. Clamped against
+        // rounding, as both are in [0, 1] mathematically.
+        const auto one_minus_h = min(max(sin_squared((lat2r + V::broadcast(lat1r)) * half) + cos_product * sin_squared(half_dlon + V::broadcast(pi / 2.f)), zero), one);
+        const auto h_clamped = min(max(h, zero), one);
+        const auto d = V::broadcast(2.f * earth_radius_km) * asin_sqrt(h_clamped, one_minus_h);
+        d.store(out);
+    }
+}
+
+void spherical_distance_batch(const LatLon &origin, const float *lat, const float *lon, float *out, std::size_t count)
+{
+    const auto lat1r = deg2rad(origin.lat);
+    const auto lon1r = deg2rad(origin.lon);
+    const auto cos_lat1 = cosf(lat1r);
+
+    std::size_t i = 0;
+    for (; i + simd::Wide::width <= count; i += simd::Wide::width)
+    {
+        haversine<simd::Wide>(lat1r, lon1r, cos_lat1, lat + i, lon + i, out + i);
+    }
+    for (; i < count; ++i)
+    {
+        haversine<simd::Scalar>(lat1r, lon1r, cos_lat1, lat + i, lon + i, out + i);
+    }
+}
+
+namespace
+{
+    // Block of the matrix worked on at a time: the column vectors of a block
+    // (3 * 4 KiB) stay in L1 while each of its rows sweeps over them
+    constexpr std::size_t matrix_block_rows = 64;
+    constexpr std::size_t matrix_block_columns = 1024;
+
+    template <typename V>
+    void chord_distance(Vec3 row, const float *x, const float *y, const float *z, float *out)
+    {
+        const auto px = V::load(x), py = V::load(y), pz = V::load(z);
+        const auto rx = V::broadcast(row.x), ry = V::broadcast(row.y), rz = V::broadcast(row.z);
+
+        const auto dx = px - rx, dy = py - ry, dz = pz - rz;
+        const auto sx = px + rx, sy = py + ry, sz = pz + rz;
+
+        const auto zero = V::broadcast(0.f);
+        const auto one = V::broadcast(1.f);
+        const auto quarter = V::broadcast(0.25f);
+        const auto h = min((dx * dx + dy * dy + dz * dz) * quarter, one);
+        const auto one_minus_h = max(min((sx * sx + sy * sy + sz * sz) * quarter, one), zero);
+        const auto d = V::broadcast(2.f * earth_radius_km) * asin_sqrt(h, one_minus_h);
+        d.store(out);
+    }
+
+    // Rows [row_begin, row_end) of the matrix, block by block
+    void distance_rows(const UnitVectorSet &rows, const UnitVectorSet &columns, float *out, std::size_t row_begin, std::size_t row_end)
+    {
+        const auto count = columns.size();
+        for (auto c0 = std::size_t{0}; c0 < count; c0 += matrix_block_columns)
+        {
+            const auto c1 = std::min(c0 + matrix_block_columns, count);
+            for (auto r = row_begin; r < row_end; ++r)
+            {
+                const Vec3 row{rows.x[r], rows.y[r], rows.z[r]};
+                const auto x = columns.x.data(), y = columns.y.data(), z = columns.z.data();
+                const auto line = out + r * count;
+
+                auto c = c0;
+                for (; c + simd::Wide::width <= c1; c += simd::Wide::width)
+                {
+                    chord_distance<simd::Wide>(row, x + c, y + c, z + c, line + c);
+                }
+                for (; c < c1; ++c)
+                {
+                    chord_distance<simd::Scalar>(row, x + c, y + c, z + c, line + c);
+                }
+            }
+        }
+    }
+}
+
+void UnitVectorSet::assign(const LatLon *points, std::size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto v = points[i].to_unit_vector();
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+}
+
+void distance_matrix(const UnitVectorSet &rows, const UnitVectorSet &columns, float *out)
+{
+    distance_rows(rows, columns, out, 0, rows.size());
+}
+
+void distance_matrix(const UnitVectorSet &rows, const UnitVectorSet &columns, float *out, ThreadPool &pool)
+{
+    pool.parallel_for(rows.size(), matrix_block_rows, [&](std::size_t begin, std::size_t end) {
+        distance_rows(rows, columns, out, begin, end);
+    });
+}
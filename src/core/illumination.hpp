@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "latlon.hpp"
+
+// Terminator cutoffs, distances from the point where the sun is directly overhead
+const auto earth_circumference_km = 40075.;
+const auto direct_illumination_cutoff = (earth_circumference_km / 2.f) * 0.50139f;
+const auto twilight_cutoff = direct_illumination_cutoff + earth_circumference_km * (6. / 360.);
+
+enum class Illumination : std::uint8_t
+{
+    Day,
+    Twilight,
+    Night,
+};
+
+// Day/night test on unit vectors
+//
+// A point is closer to the sun than a cutoff exactly when the dot product of
+// their unit vectors is above the cosine of the cutoff's central angle, so
+// once those cosines are known no distance needs to be computed.
+struct IlluminationCutoffs
+{
+    float cos_direct_illumination;
+    float cos_twilight;
+
+    // The central angles themselves, in radians
+    float direct_illumination_angle;
+    float twilight_angle;
+
+    static IlluminationCutoffs from_distances(double direct_illumination_km, double twilight_km)
+    {
+        const auto direct_illumination_angle = direct_illumination_km / earth_radius_km;
+        const auto twilight_angle = twilight_km / earth_radius_km;
+        return IlluminationCutoffs{
+            static_cast<float>(cos(direct_illumination_angle)),
+            static_cast<float>(cos(twilight_angle)),
+            static_cast<float>(direct_illumination_angle),
+            static_cast<float>(twilight_angle),
+        };
+    }
+
+    // The fixed cutoffs above
+    static IlluminationCutoffs standard()
+    {
+        return from_distances(direct_illumination_cutoff, twilight_cutoff);
+    }
+
+    // Classify a point by the dot product of its and the sun's unit vectors
+    //
+    // Branch-free so that loops over it vectorize.
+    Illumination classify(float dot) const
+    {
+        return static_cast<Illumination>((dot <= cos_direct_illumination) + (dot < cos_twilight));
+    }
+};
+
+// Continuous shadow across the twilight band, 0 up to the direct
+// illumination cutoff rising to 1 at the twilight cutoff
+//
+// A clamped linear function of the dot product used by classify(), so it
+// costs a multiply-add and two clamps with no branches. The band lies within
+// a few degrees of 90° from the sun, where the cosine is linear in the angle
+// to well under 1%.
+struct ShadowRamp
+{
+    float scale;
+    float offset;
+
+    static ShadowRamp from_cutoffs(const IlluminationCutoffs &cutoffs)
+    {
+        const auto scale = 1.f / (cutoffs.cos_twilight - cutoffs.cos_direct_illumination);
+        return ShadowRamp{scale, -cutoffs.cos_direct_illumination * scale};
+    }
+
+    float operator()(float dot) const
+    {
+        return std::min(std::max(dot * scale + offset, 0.f), 1.f);
+    }
+
+    // The same, rounded to 0..255 like the vectorized TileGrid::shade
+    std::uint8_t level(float dot) const
+    {
+        return static_cast<std::uint8_t>(std::nearbyint((*this)(dot) * 255.f));
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "vec.hpp"
+
+// Kept in float so that angle conversions don't promote to double
+constexpr float pi = 3.14159265358979f;
+
+// This function converts decimal degrees to radians
+constexpr float deg2rad(float deg)
+{
+    return deg * (pi / 180.f);
+}
+
+//  This function converts radians to decimal degrees
+constexpr float rad2deg(float rad)
+{
+    return rad * (180.f / pi);
+}
+
+// Mean radius of the earth
+const auto earth_radius_km = 6371.f;
+
+// Latitude-Longitude coordinates
+struct LatLon
+{
+    // 90° at north pole, -90° at south pole
+    float lat;
+    // 0° through London, ±180 at the other side, positive goes west
+    float lon;
+
+    // Compute the length of the path between two points along a great circle.
+    //
+    // https://en.wikipedia.org/wiki/Haversine_formula
+    //
+    // The haversine term is clamped to [0, 1], which rounding can leave it
+    // just above for nearly antipodal points.
+    float spherical_distance(const LatLon &other) const
+    {
+        const auto lat1r = deg2rad(lat);
+        const auto lon1r = deg2rad(lon);
+        const auto lat2r = deg2rad(other.lat);
+        const auto lon2r = deg2rad(other.lon);
+        const auto u = sinf((lat2r - lat1r) / 2);
+        const auto v = sinf((lon2r - lon1r) / 2);
+        const auto h = u * u + cos(lat1r) * cos(lat2r) * v * v;
+
+        return 2.0 * earth_radius_km * asin(sqrt(std::min(std::max(static_cast<double>(h), 0.), 1.)));
+    }
+
+    // Point on the unit sphere, z towards the north pole and x through London
+    //
+    // The dot product of two such vectors is the cosine of the central angle
+    // between the points.
+    Vec3 to_unit_vector() const
+    {
+        const auto latr = deg2rad(lat);
+        const auto lonr = deg2rad(lon);
+        return Vec3{cosf(latr) * cosf(lonr), cosf(latr) * sinf(lonr), sinf(latr)};
+    }
+
+    // Map to x-y representation on the azimuthal equidistant projection
+    Vec2 to_azimuthal_equidistant() const
+    {
+        const auto r = -(lat - 90.f) / 180.f;
+        const auto th = deg2rad(lon);
+        return r * Vec2{-sinf(th), cosf(th)};
+    }
+
+    // Compute LatLon from x-y azimuthal equidistant projection coordinates
+    static LatLon from_azimuthal_equidistant(Vec2 coords)
+    {
+        const auto r = sqrtf(coords.x * coords.x + coords.y * coords.y);
+        const auto th = atan2f(-coords.x, coords.y);
+
+        const auto lat = -r * 180.f + 90.f;
+        const auto lon = rad2deg(th);
+
+        return LatLon{lat, lon};
+    }
+
+    bool operator==(const LatLon &other) const
+    {
+        return lat == other.lat && lon == other.lon;
+    }
+
+    bool operator!=(const LatLon &other) const
+    {
+        return !(*this == other);
+    }
+};
@@ -0,0 +1,54 @@
+#include "places.hpp"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+    // Parse a whole field as a number
+    bool parse_number(const std::string &field, float &value)
+    {
+        const auto *begin = field.c_str();
+        char *end = nullptr;
+        value = std::strtof(begin, &end);
+        while (*end == ' ' || *end == '\t' || *end == '\r')
+        {
+            ++end;
+        }
+        return end != begin && *end == '\0';
+    }
+}
+
+bool load_places(const std::string &path, std::vector<Place> &out, std::size_t &line_error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        line_error = 0;
+        return false;
+    }
+
+    out.clear();
+    std::string line;
+    for (std::size_t number = 1; std::getline(file, line); ++number)
+    {
+        if (line.empty() || line[0] == '#' || line == "\r")
+        {
+            continue;
+        }
+
+        const auto lon_comma = line.rfind(',');
+        const auto lat_comma = lon_comma == std::string::npos || lon_comma == 0 ? std::string::npos : line.rfind(',', lon_comma - 1);
+        float lat = 0.f, lon = 0.f;
+        if (lat_comma == std::string::npos || !parse_number(line.substr(lat_comma + 1, lon_comma - lat_comma - 1), lat) ||
+            !parse_number(line.substr(lon_comma + 1), lon) || lat < -90.f || lat > 90.f || lon < -180.f || lon > 180.f)
+        {
+            line_error = number;
+            return false;
+        }
+
+        out.push_back(Place{line.substr(0, lat_comma), LatLon{lat, -lon}});
+    }
+
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "latlon.hpp"
+
+// Named point on the map
+struct Place
+{
+    std::string name;
+    LatLon coords;
+};
+
+// Read places from a CSV file of `name,latitude,longitude` lines
+//
+// Coordinates are in degrees with east positive, as in most place datasets,
+// and converted to the west-positive longitudes of LatLon. The two numbers
+// are taken from the end of the line, so names may contain commas. Empty
+// lines and lines starting with # are skipped. `line_error` is set to the
+// first malformed line, if any, including lines with a latitude outside
+// [-90, 90] or a longitude outside [-180, 180].
+bool load_places(const std::string &path, std::vector<Place> &out, std::size_t &line_error);
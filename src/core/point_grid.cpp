@@ -0,0 +1,58 @@
+#include "point_grid.hpp"
+
+#include <cmath>
+
+void PointGrid::build(const std::vector<Vec2> &points, Vec2 min, Vec2 max, float cell_size)
+{
+    this->points = points;
+    this->cell_size = cell_size;
+    origin = min;
+    columns = static_cast<std::size_t>(std::ceil((max.x - min.x) / cell_size)) + 1;
+    rows = static_cast<std::size_t>(std::ceil((max.y - min.y) / cell_size)) + 1;
+
+    // Counting sort by cell
+    cell_start.assign(columns * rows + 1, 0);
+    for (const auto &p : points)
+    {
+        ++cell_start[row(p.y) * columns + column(p.x) + 1];
+    }
+    for (std::size_t i = 1; i < cell_start.size(); ++i)
+    {
+        cell_start[i] += cell_start[i - 1];
+    }
+
+    auto next = cell_start;
+    indices.resize(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        indices[next[row(points[i].y) * columns + column(points[i].x)]++] = static_cast<std::uint32_t>(i);
+    }
+}
+
+std::size_t PointGrid::nearest(Vec2 p, float radius) const
+{
+    auto best = npos;
+    auto best_distance = radius * radius;
+    visit(p - Vec2{radius, radius}, p + Vec2{radius, radius}, [&](std::size_t i) {
+        const auto d = points[i] - p;
+        const auto distance = d.x * d.x + d.y * d.y;
+        if (distance <= best_distance)
+        {
+            best_distance = distance;
+            best = i;
+        }
+    });
+    return best;
+}
+
+std::size_t PointGrid::column(float x) const
+{
+    const auto c = std::floor((x - origin.x) / cell_size);
+    return static_cast<std::size_t>(std::min(std::max(c, 0.f), static_cast<float>(columns - 1)));
+}
+
+std::size_t PointGrid::row(float y) const
+{
+    const auto r = std::floor((y - origin.y) / cell_size);
+    return static_cast<std::size_t>(std::min(std::max(r, 0.f), static_cast<float>(rows - 1)));
+}
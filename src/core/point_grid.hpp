@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vec.hpp"
+
+// Uniform grid over a fixed set of 2D points, for range and nearest queries
+//
+// Points are bucketed by cell once, with their indices stored contiguously
+// per cell, so a query only touches the cells overlapping it instead of
+// scanning every point.
+class PointGrid
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Index `points`, which have to lie within `min` and `max`, in square cells of `cell_size`
+    void build(const std::vector<Vec2> &points, Vec2 min, Vec2 max, float cell_size);
+
+    // Call `visit(index)` for every point within the rectangle from `min` to `max`
+    template <typename Visit>
+    void visit(Vec2 min, Vec2 max, Visit &&visit) const
+    {
+        if (points.empty())
+        {
+            return;
+        }
+
+        const auto c0 = column(min.x), c1 = column(max.x);
+        const auto r0 = row(min.y), r1 = row(max.y);
+        for (auto r = r0; r <= r1; ++r)
+        {
+            for (auto c = c0; c <= c1; ++c)
+            {
+                const auto cell = r * columns + c;
+                for (auto i = cell_start[cell]; i < cell_start[cell + 1]; ++i)
+                {
+                    const auto p = points[indices[i]];
+                    if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y)
+                    {
+                        visit(static_cast<std::size_t>(indices[i]));
+                    }
+                }
+            }
+        }
+    }
+
+    // Index of the point closest to `p` within `radius`, npos if there's none
+    std::size_t nearest(Vec2 p, float radius) const;
+
+private:
+    std::size_t column(float x) const;
+    std::size_t row(float y) const;
+
+    Vec2 origin{};
+    float cell_size = 1.f;
+    std::size_t columns = 0;
+    std::size_t rows = 0;
+
+    // Point indices of cell i are indices[cell_start[i]] to indices[cell_start[i + 1]]
+    std::vector<std::size_t> cell_start;
+    std::vector<std::uint32_t> indices;
+    std::vector<Vec2> points;
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "latlon.hpp"
+#include "vec.hpp"
+
+// Map projections as policies for the code that works on map coordinates
+//
+// Code that projects is a template on one of the structs below and calls its
+// static functions, so that the exact math of the projection is inlined into
+// inner loops. Map coordinates are in [-1, 1] on both axes, x growing east
+// and y growing south, and every projection fills as much of that square as
+// its shape allows:
+//
+//   // Position of `coords`, false if the projection doesn't show it
+//   static bool forward(const LatLon &coords, Vec2 &out);
+//   // Point at `coords`, false if it's off the map
+//   static bool inverse(Vec2 coords, LatLon &out);
+//   // Half the width and height of the area the map covers
+//   static Vec2 extent();
+//   // Width in map coordinates after which the map repeats, 0 if it doesn't.
+//   // forward() doesn't wrap longitudes beyond ±180°.
+//   static float period();
+//   // Range of colatitudes shown, in degrees from the north pole
+//   static float min_colatitude();
+//   static float max_colatitude();
+//   // inverse() as a GLSL function `bool inverse(vec2 coords, out float lat, out float lon)`
+//   static const char *glsl_inverse();
+//   // Command line name, and the name of the map drawn under the projection.
+//   // Only AzimuthalEquidistant's is an image in the repo, the viewer
+//   // resamples it into the others at startup.
+//   static const char *name();
+//   static const char *map_file();
+
+// Around the north pole with distances from it kept, the original flat earth
+// map and the one the rest of the code assumes
+struct AzimuthalEquidistant
+{
+    static bool forward(const LatLon &coords, Vec2 &out)
+    {
+        out = coords.to_azimuthal_equidistant();
+        return true;
+    }
+
+    static bool inverse(Vec2 coords, LatLon &out)
+    {
+        out = LatLon::from_azimuthal_equidistant(coords);
+        return out.lat >= -90.f;
+    }
+
+    static Vec2 extent() { return Vec2{1.f, 1.f}; }
+    static float period() { return 0.f; }
+    static float min_colatitude() { return 0.f; }
+    static float max_colatitude() { return 180.f; }
+
+    static const char *glsl_inverse()
+    {
+        return R"(
+bool inverse(vec2 coords, out float lat, out float lon)
+{
+    lat = -length(coords) * 180.0 + 90.0;
+    lon = degrees(atan(-coords.x, coords.y));
+    return lat >= -90.0;
+}
+)";
+    }
+
+    static const char *name() { return "azimuthal-equidistant"; }
+    static const char *map_file() { return "map.jpg"; }
+};
+
+// Latitude and longitude as plain coordinates, a 2:1 band across the square
+struct Equirectangular
+{
+    static bool forward(const LatLon &coords, Vec2 &out)
+    {
+        out = Vec2{-coords.lon / 180.f, -coords.lat / 180.f};
+        return true;
+    }
+
+    static bool inverse(Vec2 coords, LatLon &out)
+    {
+        out = LatLon{-coords.y * 180.f, -coords.x * 180.f};
+        return std::fabs(coords.x) <= 1.f && std::fabs(coords.y) <= 0.5f;
+    }
+
+    static Vec2 extent() { return Vec2{1.f, 0.5f}; }
+    static float period() { return 2.f; }
+    static float min_colatitude() { return 0.f; }
+    static float max_colatitude() { return 180.f; }
+
+    static const char *glsl_inverse()
+    {
+        return R"(
+bool inverse(vec2 coords, out float lat, out float lon)
+{
+    lat = -coords.y * 180.0;
+    lon = -coords.x * 180.0;
+    return abs(coords.x) <= 1.0 && abs(coords.y) <= 0.5;
+}
+)";
+    }
+
+    static const char *name() { return "equirectangular"; }
+    static const char *map_file() { return "map_equirectangular"; }
+};
+
+// The northern hemisphere as seen from far above the north pole
+struct Orthographic
+{
+    static bool forward(const LatLon &coords, Vec2 &out)
+    {
+        const auto r = std::cos(deg2rad(coords.lat));
+        const auto th = deg2rad(coords.lon);
+        out = r * Vec2{-std::sin(th), std::cos(th)};
+        return coords.lat >= 0.f;
+    }
+
+    static bool inverse(Vec2 coords, LatLon &out)
+    {
+        const auto r = std::sqrt(coords.x * coords.x + coords.y * coords.y);
+        out = LatLon{rad2deg(std::acos(std::min(r, 1.f))), rad2deg(std::atan2(-coords.x, coords.y))};
+        return r <= 1.f;
+    }
+
+    static Vec2 extent() { return Vec2{1.f, 1.f}; }
+    static float period() { return 0.f; }
+    static float min_colatitude() { return 0.f; }
+    static float max_colatitude() { return 90.f; }
+
+    static const char *glsl_inverse()
+    {
+        return R"(
+bool inverse(vec2 coords, out float lat, out float lon)
+{
+    float r = length(coords);
+    lat = degrees(acos(min(r, 1.0)));
+    lon = degrees(atan(-coords.x, coords.y));
+    return r <= 1.0;
+}
+)";
+    }
+
+    static const char *name() { return "orthographic"; }
+    static const char *map_file() { return "map_orthographic"; }
+};
+
+// Conformal cylindrical projection, cut off where it becomes square
+struct Mercator
+{
+    // Latitude at which the projection is as tall as it's wide
+    static float max_latitude() { return 85.051129f; }
+
+    static bool forward(const LatLon &coords, Vec2 &out)
+    {
+        const auto lat = std::min(std::max(coords.lat, -max_latitude()), max_latitude());
+        out = Vec2{-coords.lon / 180.f, -std::log(std::tan(pi / 4.f + deg2rad(lat) / 2.f)) / pi};
+        return std::fabs(coords.lat) <= max_latitude();
+    }
+
+    static bool inverse(Vec2 coords, LatLon &out)
+    {
+        out = LatLon{rad2deg(2.f * std::atan(std::exp(-coords.y * pi)) - pi / 2.f), -coords.x * 180.f};
+        return std::fabs(coords.x) <= 1.f && std::fabs(coords.y) <= 1.f;
+    }
+
+    static Vec2 extent() { return Vec2{1.f, 1.f}; }
+    static float period() { return 2.f; }
+    static float min_colatitude() { return 90.f - max_latitude(); }
+    static float max_colatitude() { return 90.f + max_latitude(); }
+
+    static const char *glsl_inverse()
+    {
+        return R"(
+bool inverse(vec2 coords, out float lat, out float lon)
+{
+    lat = degrees(2.0 * atan(exp(-coords.y * 3.14159265)) - 1.57079633);
+    lon = -coords.x * 180.0;
+    return abs(coords.x) <= 1.0 && abs(coords.y) <= 1.0;
+}
+)";
+    }
+
+    static const char *name() { return "mercator"; }
+    static const char *map_file() { return "map_mercator"; }
+};
+
+// Names of all projections, for usage messages
+inline const char *projection_names()
+{
+    return "azimuthal-equidistant | equirectangular | orthographic | mercator";
+}
+
+// Call `visit(projection)` with a value of the projection called `name`,
+// false if there's none by that name
+template <typename Visit>
+bool with_projection(const std::string &name, Visit &&visit)
+{
+    if (name == AzimuthalEquidistant::name())
+    {
+        visit(AzimuthalEquidistant{});
+    }
+    else if (name == Equirectangular::name())
+    {
+        visit(Equirectangular{});
+    }
+    else if (name == Orthographic::name())
+    {
+        visit(Orthographic{});
+    }
+    else if (name == Mercator::name())
+    {
+        visit(Mercator{});
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,220 @@
+#include "quadtree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+    // Side of the blocks the recursion starts from
+    const std::size_t root_tiles = 64;
+
+    // Blocks of at most this many tiles are evaluated without splitting
+    const std::size_t leaf_tiles = 4;
+
+    // Margin for float rounding in the acceptance test, in radians
+    const auto accept_margin = 1e-4f;
+
+    struct Quadtree
+    {
+        Vec3 sun;
+        const IlluminationCutoffs &cutoffs;
+        std::size_t side;
+        float step;
+        float radius;
+        Illumination *out;
+        // Optional, ShadowRamp levels
+        std::uint8_t *shade;
+        ShadowRamp ramp;
+        std::size_t evaluations = 0;
+
+        // Map coordinates of tile (tx, ty) as in TileGrid::build, also for
+        // fractional centers of blocks
+        Vec2 position(float tx, float ty) const
+        {
+            return (Vec2{tx * step, ty * step} - Vec2{radius, radius}) / radius;
+        }
+
+        // Same test as TileGrid::build, so that both skip the same tiles
+        static bool on_map(Vec2 p)
+        {
+            return -sqrtf(p.x * p.x + p.y * p.y) * 180.f + 90.f >= -90.f;
+        }
+
+        // Dot product of the sun with the point at `p`, inlined
+        // LatLon::from_azimuthal_equidistant and to_unit_vector
+        float sun_dot(Vec2 p)
+        {
+            ++evaluations;
+            const auto r = std::sqrt(p.x * p.x + p.y * p.y);
+            if (r == 0.f)
+            {
+                return sun.z;
+            }
+
+            // Colatitude is π r, the longitude direction (cos, sin) is (y, -x) / r
+            const auto sin_colatitude = sinf(pi * r);
+            const auto cos_colatitude = cosf(pi * r);
+            return sin_colatitude * (p.y * sun.x - p.x * sun.y) / r + cos_colatitude * sun.z;
+        }
+
+        // Fill with `illumination`, and with Day the tiles off the map if `rim`
+        void evaluate(std::size_t tx, std::size_t ty)
+        {
+            const auto p = position(static_cast<float>(tx), static_cast<float>(ty));
+            const auto on = on_map(p);
+            const auto dot = on ? sun_dot(p) : 1.f;
+            out[ty * side + tx] = cutoffs.classify(dot);
+            if (shade)
+            {
+                shade[ty * side + tx] = ramp.level(dot);
+            }
+        }
+
+        void fill(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1, Illumination illumination, bool rim)
+        {
+            for (auto ty = y0; ty < y1; ++ty)
+            {
+                // Tiles of a row on the map are contiguous, the disc being convex
+                auto begin = x0;
+                auto end = x1;
+                while (rim && begin < end && !on_map(position(static_cast<float>(begin), static_cast<float>(ty))))
+                {
+                    ++begin;
+                }
+                while (rim && begin < end && !on_map(position(static_cast<float>(end - 1), static_cast<float>(ty))))
+                {
+                    --end;
+                }
+
+                std::fill(out + ty * side + x0, out + ty * side + begin, Illumination::Day);
+                std::fill(out + ty * side + begin, out + ty * side + end, illumination);
+                std::fill(out + ty * side + end, out + ty * side + x1, Illumination::Day);
+                if (shade)
+                {
+                    const std::uint8_t level = illumination == Illumination::Night ? 255 : 0;
+                    std::fill(shade + ty * side + x0, shade + ty * side + begin, 0);
+                    std::fill(shade + ty * side + begin, shade + ty * side + end, level);
+                    std::fill(shade + ty * side + end, shade + ty * side + x1, 0);
+                }
+            }
+        }
+
+        void classify(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1)
+        {
+            // Tiles closest to and furthest from the map center
+            const auto map_center = radius / step;
+            const auto nearest = [&](std::size_t a0, std::size_t a1) {
+                return std::min(std::max(std::round(map_center), static_cast<float>(a0)), static_cast<float>(a1 - 1));
+            };
+            const auto furthest = [&](std::size_t a0, std::size_t a1) {
+                return std::abs(static_cast<float>(a0) - map_center) > std::abs(static_cast<float>(a1 - 1) - map_center) ? static_cast<float>(a0) : static_cast<float>(a1 - 1);
+            };
+
+            if (!on_map(position(nearest(x0, x1), nearest(y0, y1))))
+            {
+                fill(x0, y0, x1, y1, Illumination::Day, false);
+                return;
+            }
+            const auto rim = !on_map(position(furthest(x0, x1), furthest(y0, y1)));
+
+            // Small blocks are cheaper to evaluate tile by tile than to test and split
+            if ((x1 - x0) * (y1 - y0) <= leaf_tiles)
+            {
+                for (auto ty = y0; ty < y1; ++ty)
+                {
+                    for (auto tx = x0; tx < x1; ++tx)
+                    {
+                        evaluate(tx, ty);
+                    }
+                }
+                return;
+            }
+
+            // A map distance d spans a central angle of at most π d (the map
+            // radius being 1, and the disc being convex), so all tiles are
+            // within `extent` of the center
+            const auto center = position(static_cast<float>(x0 + x1 - 1) / 2.f, static_cast<float>(y0 + y1 - 1) / 2.f);
+            if (on_map(center))
+            {
+                const auto half_x = static_cast<float>(x1 - 1 - x0) / 2.f * step / radius;
+                const auto half_y = static_cast<float>(y1 - 1 - y0) / 2.f * step / radius;
+                const auto extent = pi * std::sqrt(half_x * half_x + half_y * half_y) + accept_margin;
+
+                const auto dot = sun_dot(center);
+                const auto angle = acosf(std::min(std::max(dot, -1.f), 1.f));
+                // With shades only wholly lit or dark blocks are uniform
+                const auto day = angle + extent < cutoffs.direct_illumination_angle;
+                const auto night = angle - extent > cutoffs.twilight_angle;
+                const auto twilight = angle - extent > cutoffs.direct_illumination_angle && angle + extent < cutoffs.twilight_angle;
+                if (day || night || (twilight && !shade))
+                {
+                    fill(x0, y0, x1, y1, cutoffs.classify(dot), rim);
+                    return;
+                }
+            }
+
+            const auto xm = x1 - x0 > 1 ? (x0 + x1) / 2 : x1;
+            const auto ym = y1 - y0 > 1 ? (y0 + y1) / 2 : y1;
+            classify(x0, y0, xm, ym);
+            if (xm < x1)
+            {
+                classify(xm, y0, x1, ym);
+            }
+            if (ym < y1)
+            {
+                classify(x0, ym, xm, y1);
+            }
+            if (xm < x1 && ym < y1)
+            {
+                classify(xm, ym, x1, y1);
+            }
+        }
+
+        // Top-level block `index` of the row-major grid of root blocks
+        void classify_root(std::size_t index)
+        {
+            const auto roots = (side + root_tiles - 1) / root_tiles;
+            const auto x0 = index % roots * root_tiles;
+            const auto y0 = index / roots * root_tiles;
+            classify(x0, y0, std::min(x0 + root_tiles, side), std::min(y0 + root_tiles, side));
+        }
+    };
+}
+
+std::size_t quadtree_side(float size, float step)
+{
+    return static_cast<std::size_t>(std::ceil(size / step));
+}
+
+std::size_t classify_quadtree(const LatLon &sun, const IlluminationCutoffs &cutoffs, float size, float step, Illumination *out, std::uint8_t *shade)
+{
+    const auto side = quadtree_side(size, step);
+    Quadtree tree{sun.to_unit_vector(), cutoffs, side, step, size / 2.f, out, shade, ShadowRamp::from_cutoffs(cutoffs)};
+
+    const auto roots = (side + root_tiles - 1) / root_tiles;
+    for (std::size_t i = 0; i < roots * roots; ++i)
+    {
+        tree.classify_root(i);
+    }
+    return tree.evaluations;
+}
+
+std::size_t classify_quadtree(const LatLon &sun, const IlluminationCutoffs &cutoffs, float size, float step, Illumination *out, std::uint8_t *shade, ThreadPool &pool)
+{
+    const auto side = quadtree_side(size, step);
+    const auto s = sun.to_unit_vector();
+    std::atomic<std::size_t> evaluations{0};
+
+    const auto roots = (side + root_tiles - 1) / root_tiles;
+    pool.parallel_for(roots * roots, 1, [&](std::size_t begin, std::size_t end) {
+        Quadtree tree{s, cutoffs, side, step, size / 2.f, out, shade, ShadowRamp::from_cutoffs(cutoffs)};
+        for (auto i = begin; i < end; ++i)
+        {
+            tree.classify_root(i);
+        }
+        evaluations += tree.evaluations;
+    });
+    return evaluations;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "illumination.hpp"
+#include "latlon.hpp"
+#include "thread_pool.hpp"
+
+// Illumination of the same tiles as TileGrid::build(size, step), as a
+// row-major raster of ceil(size / step) tiles per side written to `out`
+//
+// Works top-down on a quadtree instead of tile by tile: a block is
+// classified from the tile at its center alone if every tile in it is
+// provably on the same side of both cutoffs, and split in four otherwise.
+// Uniform regions cost a handful of evaluations, only the tiles along the
+// terminator and the map rim are evaluated one by one. Tiles off the map are
+// Day, so that they get no shadow.
+//
+// If `shade` isn't null the ShadowRamp levels are written to it as well,
+// which leaves only the wholly lit and dark blocks uniform.
+//
+// Returns the number of evaluated tiles.
+std::size_t classify_quadtree(const LatLon &sun, const IlluminationCutoffs &cutoffs, float size, float step, Illumination *out, std::uint8_t *shade);
+
+// Same, with the top-level blocks spread over `pool`
+std::size_t classify_quadtree(const LatLon &sun, const IlluminationCutoffs &cutoffs, float size, float step, Illumination *out, std::uint8_t *shade, ThreadPool &pool);
+
+// Tiles per side of the classify_quadtree raster
+std::size_t quadtree_side(float size, float step);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Thin wrappers over the widest float vector the target supports, so that
+// kernels can be written once as templates over the lane type.
+//
+// Comparisons return masks of the same type, to be consumed by select().
+namespace simd
+{
+    // Single lane fallback, also used for the tails of vectorized loops
+    struct Scalar
+    {
+        static constexpr std::size_t width = 1;
+
+        float v;
+
+        static Scalar load(const float *p) { return {*p}; }
+        static Scalar broadcast(float f) { return {f}; }
+        void store(float *p) const { *p = v; }
+
+        friend Scalar operator+(Scalar a, Scalar b) { return {a.v + b.v}; }
+        friend Scalar operator-(Scalar a, Scalar b) { return {a.v - b.v}; }
+        friend Scalar operator*(Scalar a, Scalar b) { return {a.v * b.v}; }
+        friend Scalar operator/(Scalar a, Scalar b) { return {a.v / b.v}; }
+        friend Scalar sqrt(Scalar a) { return {sqrtf(a.v)}; }
+        friend Scalar min(Scalar a, Scalar b) { return {a.v < b.v ? a.v : b.v}; }
+        friend Scalar max(Scalar a, Scalar b) { return {a.v > b.v ? a.v : b.v}; }
+        friend Scalar abs(Scalar a) { return {fabsf(a.v)}; }
+        friend Scalar round(Scalar a) { return {nearbyintf(a.v)}; }
+        friend Scalar greater(Scalar a, Scalar b) { return {a.v > b.v ? 1.f : 0.f}; }
+        friend Scalar select(Scalar mask, Scalar a, Scalar b) { return mask.v != 0.f ? a : b; }
+    };
+
+#if defined(__AVX2__)
+    struct Wide
+    {
+        static constexpr std::size_t width = 8;
+
+        __m256 v;
+
+        static Wide load(const float *p) { return {_mm256_loadu_ps(p)}; }
+        static Wide broadcast(float f) { return {_mm256_set1_ps(f)}; }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+        friend Wide operator+(Wide a, Wide b) { return {_mm256_add_ps(a.v, b.v)}; }
+        friend Wide operator-(Wide a, Wide b) { return {_mm256_sub_ps(a.v, b.v)}; }
+        friend Wide operator*(Wide a, Wide b) { return {_mm256_mul_ps(a.v, b.v)}; }
+        friend Wide operator/(Wide a, Wide b) { return {_mm256_div_ps(a.v, b.v)}; }
+        friend Wide sqrt(Wide a) { return {_mm256_sqrt_ps(a.v)}; }
+        friend Wide min(Wide a, Wide b) { return {_mm256_min_ps(a.v, b.v)}; }
+        friend Wide max(Wide a, Wide b) { return {_mm256_max_ps(a.v, b.v)}; }
+        friend Wide abs(Wide a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v)}; }
+        friend Wide round(Wide a) { return {_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)}; }
+        friend Wide greater(Wide a, Wide b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+        friend Wide select(Wide mask, Wide a, Wide b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+    };
+#elif defined(__SSE2__) || defined(_M_X64)
+    struct Wide
+    {
+        static constexpr std::size_t width = 4;
+
+        __m128 v;
+
+        static Wide load(const float *p) { return {_mm_loadu_ps(p)}; }
+        static Wide broadcast(float f) { return {_mm_set1_ps(f)}; }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+
+        friend Wide operator+(Wide a, Wide b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend Wide operator-(Wide a, Wide b) { return {_mm_sub_ps(a.v, b.v)}; }
+        friend Wide operator*(Wide a, Wide b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend Wide operator/(Wide a, Wide b) { return {_mm_div_ps(a.v, b.v)}; }
+        friend Wide sqrt(Wide a) { return {_mm_sqrt_ps(a.v)}; }
+        friend Wide min(Wide a, Wide b) { return {_mm_min_ps(a.v, b.v)}; }
+        friend Wide max(Wide a, Wide b) { return {_mm_max_ps(a.v, b.v)}; }
+        friend Wide abs(Wide a) { return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)}; }
+        // Uses the default round-to-nearest mode, no SSE4.1 needed
+        friend Wide round(Wide a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+        friend Wide greater(Wide a, Wide b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+        friend Wide select(Wide mask, Wide a, Wide b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+    };
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    struct Wide
+    {
+        static constexpr std::size_t width = 4;
+
+        float32x4_t v;
+
+        static Wide load(const float *p) { return {vld1q_f32(p)}; }
+        static Wide broadcast(float f) { return {vdupq_n_f32(f)}; }
+        void store(float *p) const { vst1q_f32(p, v); }
+
+        friend Wide operator+(Wide a, Wide b) { return {vaddq_f32(a.v, b.v)}; }
+        friend Wide operator-(Wide a, Wide b) { return {vsubq_f32(a.v, b.v)}; }
+        friend Wide operator*(Wide a, Wide b) { return {vmulq_f32(a.v, b.v)}; }
+        friend Wide operator/(Wide a, Wide b) { return {vdivq_f32(a.v, b.v)}; }
+        friend Wide sqrt(Wide a) { return {vsqrtq_f32(a.v)}; }
+        friend Wide min(Wide a, Wide b) { return {vminq_f32(a.v, b.v)}; }
+        friend Wide max(Wide a, Wide b) { return {vmaxq_f32(a.v, b.v)}; }
+        friend Wide abs(Wide a) { return {vabsq_f32(a.v)}; }
+        friend Wide round(Wide a) { return {vrndnq_f32(a.v)}; }
+        friend Wide greater(Wide a, Wide b) { return {vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v))}; }
+        friend Wide select(Wide mask, Wide a, Wide b) { return {vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)}; }
+    };
+#else
+    using Wide = Scalar;
+#endif
+
+}
@@ -0,0 +1,117 @@
+#include "solar.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const auto seconds_per_day = 86400.;
+
+    // Julian date of the unix epoch and of J2000.0
+    const auto unix_epoch_jd = 2440587.5;
+    const auto j2000_jd = 2451545.0;
+
+    const auto deg = 3.14159265358979323846 / 180.;
+
+    // Wrap degrees to [-180, 180)
+    double wrap_degrees(double angle)
+    {
+        return angle - 360. * std::floor((angle + 180.) / 360.);
+    }
+
+    // Days since 1970-01-01 of a proleptic Gregorian date
+    //
+    // http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+    std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2;
+        const auto era = (y >= 0 ? y : y - 399) / 400;
+        const auto yoe = static_cast<unsigned>(y - era * 400);
+        const auto doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+    }
+
+    // Inverse of days_from_civil
+    void civil_from_days(std::int64_t z, std::int64_t &y, unsigned &m, unsigned &d)
+    {
+        z += 719468;
+        const auto era = (z >= 0 ? z : z - 146096) / 146097;
+        const auto doe = static_cast<unsigned>(z - era * 146097);
+        const auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const auto mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = static_cast<std::int64_t>(yoe) + era * 400 + (m <= 2);
+    }
+}
+
+LatLon subsolar_point(double unix_seconds)
+{
+    // Days since J2000.0
+    const auto n = unix_seconds / seconds_per_day + unix_epoch_jd - j2000_jd;
+
+    // Mean longitude and mean anomaly of the sun, ecliptic longitude and
+    // obliquity of the ecliptic, all in degrees
+    const auto mean_longitude = 280.460 + 0.9856474 * n;
+    const auto mean_anomaly = 357.528 + 0.9856003 * n;
+    const auto ecliptic_longitude = mean_longitude + 1.915 * std::sin(mean_anomaly * deg) + 0.020 * std::sin(2. * mean_anomaly * deg);
+    const auto obliquity = 23.439 - 0.0000004 * n;
+
+    const auto right_ascension = std::atan2(std::cos(obliquity * deg) * std::sin(ecliptic_longitude * deg), std::cos(ecliptic_longitude * deg)) / deg;
+    const auto declination = std::asin(std::sin(obliquity * deg) * std::sin(ecliptic_longitude * deg)) / deg;
+
+    // Equation of time in degrees, how far the true sun is ahead of the mean sun
+    const auto equation_of_time = wrap_degrees(mean_longitude - right_ascension);
+
+    // The mean sun is over Greenwich at 12:00 UTC and moves 15° west per hour
+    const auto utc_hours = 24. * (unix_seconds / seconds_per_day - std::floor(unix_seconds / seconds_per_day));
+    const auto lon = wrap_degrees(15. * (utc_hours - 12.) + equation_of_time);
+
+    return LatLon{static_cast<float>(declination), static_cast<float>(lon)};
+}
+
+bool parse_utc(const std::string &text, std::int64_t &unix_seconds)
+{
+    int year = 0;
+    unsigned month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    char separator = 0;
+    int consumed = 0;
+
+    const auto fields = std::sscanf(text.c_str(), "%d-%u-%u%c%u:%u%n:%u%n", &year, &month, &day, &separator, &hour, &minute, &consumed, &second, &consumed);
+    if (fields < 6 || (separator != 'T' && separator != ' ') || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+    {
+        return false;
+    }
+
+    // Only an optional Z may follow
+    const auto rest = text.substr(static_cast<std::size_t>(consumed));
+    if (!rest.empty() && rest != "Z")
+    {
+        return false;
+    }
+
+    unix_seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+std::string format_utc(std::int64_t unix_seconds)
+{
+    auto days = unix_seconds / 86400;
+    auto seconds = unix_seconds % 86400;
+    if (seconds < 0)
+    {
+        seconds += 86400;
+        --days;
+    }
+
+    std::int64_t year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+
+    char out[32];
+    std::snprintf(out, sizeof(out), "%04lld%02u%02uT%02u%02u%02uZ", static_cast<long long>(year), month, day,
+                  static_cast<unsigned>(seconds / 3600), static_cast<unsigned>(seconds / 60 % 60), static_cast<unsigned>(seconds % 60));
+    return out;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "latlon.hpp"
+
+// Point where the sun is directly overhead at `unix_seconds` (UTC)
+//
+// Low precision solar coordinates from the Astronomical Almanac: declination
+// gives the latitude, and the equation of time offsets the longitude from the
+// one where it's noon by the clock. Good to about 0.01° for 1950-2050.
+LatLon subsolar_point(double unix_seconds);
+
+// Parse "YYYY-MM-DDTHH:MM[:SS][Z]" as UTC, also with a space instead of T
+bool parse_utc(const std::string &text, std::int64_t &unix_seconds);
+
+// "YYYYMMDDTHHMMSSZ", safe for file names
+std::string format_utc(std::int64_t unix_seconds);
@@ -0,0 +1,194 @@
+#include "sphere_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Squared straight-line distance between unit vectors
+    float chord2(Vec3 a, Vec3 b)
+    {
+        const auto dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Squared distance from `p` to the closest point of a box
+    float box_distance2(Vec3 p, Vec3 min, Vec3 max)
+    {
+        const auto dx = std::max(std::max(min.x - p.x, p.x - max.x), 0.f);
+        const auto dy = std::max(std::max(min.y - p.y, p.y - max.y), 0.f);
+        const auto dz = std::max(std::max(min.z - p.z, p.z - max.z), 0.f);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    float axis(Vec3 v, int a)
+    {
+        return a == 0 ? v.x : a == 1 ? v.y : v.z;
+    }
+
+    // Great-circle distance for a squared chord
+    float chord2_to_km(float c2)
+    {
+        return 2.f * earth_radius_km * std::asin(std::min(std::sqrt(c2) / 2.f, 1.f));
+    }
+
+    bool closer(const SphereIndex::Hit &a, const SphereIndex::Hit &b)
+    {
+        return a.distance < b.distance;
+    }
+}
+
+void SphereIndex::build(const LatLon *points, std::size_t count)
+{
+    // Splitting permutes only the indices, the vectors are put in tree order
+    // once it's done
+    vectors.resize(count);
+    indices.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        vectors[i] = points[i].to_unit_vector();
+        indices[i] = static_cast<std::uint32_t>(i);
+    }
+
+    nodes.clear();
+    if (count > 0)
+    {
+        nodes.reserve(2 * (count / leaf_points) + 1);
+        nodes.emplace_back();
+        split(0, 0, static_cast<std::uint32_t>(count));
+    }
+
+    const auto input = vectors;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        vectors[i] = input[indices[i]];
+    }
+}
+
+void SphereIndex::split(std::uint32_t node, std::uint32_t begin, std::uint32_t end)
+{
+    auto min = vectors[indices[begin]], max = min;
+    for (auto i = begin + 1; i < end; ++i)
+    {
+        const auto v = vectors[indices[i]];
+        min = Vec3{std::min(min.x, v.x), std::min(min.y, v.y), std::min(min.z, v.z)};
+        max = Vec3{std::max(max.x, v.x), std::max(max.y, v.y), std::max(max.z, v.z)};
+    }
+    nodes[node] = Node{min, max, begin, end, 0};
+
+    if (end - begin <= leaf_points)
+    {
+        return;
+    }
+
+    // Split across the widest side of the box at the median
+    const Vec3 extent{max.x - min.x, max.y - min.y, max.z - min.z};
+    const auto a = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end, [&](std::uint32_t l, std::uint32_t r) {
+        return axis(vectors[l], a) < axis(vectors[r], a);
+    });
+
+    const auto child = static_cast<std::uint32_t>(nodes.size());
+    nodes[node].child = child;
+    nodes.emplace_back();
+    nodes.emplace_back();
+    split(child, begin, middle);
+    split(child + 1, middle, end);
+}
+
+void SphereIndex::nearest(const LatLon &p, std::size_t k, std::vector<Hit> &out) const
+{
+    out.clear();
+    if (k == 0 || nodes.empty())
+    {
+        return;
+    }
+
+    // Max-heap of the best k so far, by squared chord until the end
+    nearest(0, p.to_unit_vector(), k, out);
+    std::sort_heap(out.begin(), out.end(), closer);
+    for (auto &hit : out)
+    {
+        hit.distance = chord2_to_km(hit.distance);
+    }
+}
+
+void SphereIndex::nearest(std::uint32_t node, Vec3 p, std::size_t k, std::vector<Hit> &heap) const
+{
+    const auto &n = nodes[node];
+    if (n.child == 0)
+    {
+        for (auto i = n.begin; i < n.end; ++i)
+        {
+            const auto d = chord2(p, vectors[i]);
+            if (heap.size() < k)
+            {
+                heap.push_back(Hit{indices[i], d});
+                std::push_heap(heap.begin(), heap.end(), closer);
+            }
+            else if (d < heap.front().distance)
+            {
+                std::pop_heap(heap.begin(), heap.end(), closer);
+                heap.back() = Hit{indices[i], d};
+                std::push_heap(heap.begin(), heap.end(), closer);
+            }
+        }
+        return;
+    }
+
+    // Nearer child first, so that the other one is more likely pruned
+    auto near = n.child, far = n.child + 1;
+    auto near_bound = box_distance2(p, nodes[near].min, nodes[near].max);
+    auto far_bound = box_distance2(p, nodes[far].min, nodes[far].max);
+    if (far_bound < near_bound)
+    {
+        std::swap(near, far);
+        std::swap(near_bound, far_bound);
+    }
+    if (heap.size() < k || near_bound < heap.front().distance)
+    {
+        nearest(near, p, k, heap);
+    }
+    if (heap.size() < k || far_bound < heap.front().distance)
+    {
+        nearest(far, p, k, heap);
+    }
+}
+
+void SphereIndex::within(const LatLon &p, float radius_km, std::vector<Hit> &out) const
+{
+    out.clear();
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    // Chord of the radius, anything at all past the antipode
+    const auto angle = radius_km / earth_radius_km;
+    const auto chord = angle >= pi ? 2.f : 2.f * std::sin(angle / 2.f);
+    within(0, p.to_unit_vector(), chord * chord, out);
+}
+
+void SphereIndex::within(std::uint32_t node, Vec3 p, float limit2, std::vector<Hit> &out) const
+{
+    const auto &n = nodes[node];
+    if (box_distance2(p, n.min, n.max) > limit2)
+    {
+        return;
+    }
+    if (n.child == 0)
+    {
+        for (auto i = n.begin; i < n.end; ++i)
+        {
+            const auto d = chord2(p, vectors[i]);
+            if (d <= limit2)
+            {
+                out.push_back(Hit{indices[i], chord2_to_km(d)});
+            }
+        }
+        return;
+    }
+    within(n.child, p, limit2, out);
+    within(n.child + 1, p, limit2, out);
+}
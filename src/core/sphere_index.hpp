@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "latlon.hpp"
+#include "vec.hpp"
+
+// k-d tree over the unit vectors of a fixed set of points, for nearest and
+// radius queries by great-circle distance
+//
+// The straight line between two unit vectors grows monotonically with the
+// great-circle distance between their points, so a query searches in 3D
+// Euclidean space and converts to kilometers only for the points it returns.
+// Nodes keep the bounding box of their points, which lets a query skip every
+// subtree that can't hold a closer point.
+class SphereIndex
+{
+public:
+    struct Hit
+    {
+        std::size_t index;
+        // Great-circle distance in km
+        float distance;
+    };
+
+    // Index `count` points, all built at once by splitting at the median
+    void build(const LatLon *points, std::size_t count);
+
+    std::size_t size() const { return vectors.size(); }
+
+    // The up to `k` points closest to `p`, nearest first
+    //
+    // `out` is overwritten and its capacity reused, so repeated queries
+    // don't allocate.
+    void nearest(const LatLon &p, std::size_t k, std::vector<Hit> &out) const;
+
+    // All points within `radius_km` of `p`, in no particular order
+    void within(const LatLon &p, float radius_km, std::vector<Hit> &out) const;
+
+private:
+    struct Node
+    {
+        Vec3 min, max;
+        // Range of `vectors` under this node
+        std::uint32_t begin, end;
+        // Index of the first of two children, which are adjacent, 0 for a leaf
+        std::uint32_t child;
+    };
+
+    static constexpr std::size_t leaf_points = 8;
+
+    // Fill in `node` for indices [begin, end) and create its children
+    void split(std::uint32_t node, std::uint32_t begin, std::uint32_t end);
+
+    void nearest(std::uint32_t node, Vec3 p, std::size_t k, std::vector<Hit> &heap) const;
+    void within(std::uint32_t node, Vec3 p, float limit2, std::vector<Hit> &out) const;
+
+    std::vector<Node> nodes;
+    // Unit vectors in tree order, and the input index of each
+    std::vector<Vec3> vectors;
+    std::vector<std::uint32_t> indices;
+};
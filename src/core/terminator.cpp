@@ -0,0 +1,55 @@
+#include "terminator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Half-width of the arc of a meridian further than `cutoff` cosine from
+    // the sun, given the amplitude of the dot product with the sun along it
+    float half_width(float amplitude, float cos_cutoff)
+    {
+        // Points of the arc satisfy amplitude * cos(c - center) >= -cos_cutoff
+        if (amplitude <= -cos_cutoff)
+        {
+            return 0.f;
+        }
+        return acosf(-cos_cutoff / amplitude);
+    }
+}
+
+void meridian_shadows(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::size_t meridians, std::vector<MeridianShadow> &out)
+{
+    const auto s = sun.to_unit_vector();
+
+    out.resize(meridians + 1);
+    for (std::size_t i = 0; i <= meridians; ++i)
+    {
+        const auto lon = 2.f * pi * static_cast<float>(i % meridians) / static_cast<float>(meridians);
+
+        // Along the meridian the dot product with the sun is
+        // sin(c) * h + cos(c) * s.z = amplitude * cos(c - phase)
+        const auto h = s.x * cosf(lon) + s.y * sinf(lon);
+        const auto amplitude = std::sqrt(h * h + s.z * s.z);
+
+        // Shadow is centered opposite of the sun, taken in the turn closest
+        // to [0, π] so that the arc clips against the poles instead of wrapping
+        auto center = atan2f(h, s.z) + pi;
+        if (center > 1.5f * pi)
+        {
+            center -= 2.f * pi;
+        }
+
+        const auto twilight = half_width(amplitude, cutoffs.cos_direct_illumination);
+        const auto night = half_width(amplitude, cutoffs.cos_twilight);
+        const auto clip = [](float colatitude) { return std::min(std::max(colatitude, 0.f), pi); };
+
+        out[i] = MeridianShadow{
+            lon,
+            clip(center - twilight),
+            clip(center - night),
+            clip(center + night),
+            clip(center + twilight),
+        };
+    }
+}
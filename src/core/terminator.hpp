@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "illumination.hpp"
+#include "latlon.hpp"
+
+// Shadowed part of one meridian of the map, as colatitudes in radians
+//
+// The regions beyond the cutoffs are spherical caps around the antisolar
+// point, and a meridian crosses a cap along a single arc. From
+// `twilight_begin` to `night_begin` and from `night_end` to `twilight_end`
+// the meridian is in twilight, in between it's in night. Empty arcs collapse
+// to the point of the meridian closest to the cap, so consecutive meridians
+// always join into a closed outline.
+struct MeridianShadow
+{
+    // Longitude in radians, positive west
+    float lon;
+
+    float twilight_begin;
+    float night_begin;
+    float night_end;
+    float twilight_end;
+
+    // Point of the meridian at `colatitude`, with the north pole at 0
+    LatLon at(float colatitude) const
+    {
+        return LatLon{90.f - rad2deg(colatitude), rad2deg(lon)};
+    }
+};
+
+// Shadow along `meridians` evenly spaced meridians, plus a copy of the first
+// one at the end to close the outline, written to `out`
+//
+// Analytic counterpart of TileGrid::classify: neighbouring meridians span
+// quads whose corners are exact boundary points, so the cost depends on the
+// number of meridians and not on the output resolution. Assumes cutoffs
+// beyond 90° from the sun, as with the standard ones.
+void meridian_shadows(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::size_t meridians, std::vector<MeridianShadow> &out);
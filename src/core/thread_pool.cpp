@@ -0,0 +1,154 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+{
+    thread_count = std::max<std::size_t>(thread_count, 1);
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (std::size_t i = 1; i < thread_count; ++i)
+    {
+        workers.emplace_back(&ThreadPool::worker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, std::size_t grain, const Body &body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grain = std::max<std::size_t>(grain, 1);
+    const auto chunks = (count + grain - 1) / grain;
+
+    // Nothing to share, skip the queues
+    if (chunks == 1 || queues.size() == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    Job job;
+    job.body = &body;
+    job.remaining = chunks;
+
+    // Counted before the tasks are published, so that a worker taking one
+    // right away never decrements the count below zero
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        queued += chunks;
+    }
+
+    // Deal consecutive chunks to consecutive queues, so that each thread starts
+    // on its own contiguous band of the range
+    const auto per_queue = (chunks + queues.size() - 1) / queues.size();
+    for (std::size_t q = 0; q < queues.size(); ++q)
+    {
+        std::lock_guard<std::mutex> lock(queues[q]->mutex);
+        auto &tasks = queues[q]->tasks;
+        tasks.erase(tasks.begin(), tasks.begin() + queues[q]->head);
+        queues[q]->head = 0;
+        for (auto c = q * per_queue; c < std::min(chunks, (q + 1) * per_queue); ++c)
+        {
+            tasks.push_back(Task{&job, c * grain, std::min(count, (c + 1) * grain)});
+        }
+    }
+
+    wake.notify_all();
+
+    // Help until every chunk of this job has been taken, then wait for the
+    // ones still running on other threads
+    Task task;
+    while (job.remaining > 0 && pop(0, task))
+    {
+        run(task);
+    }
+
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&] { return job.remaining == 0; });
+}
+
+std::size_t ThreadPool::default_thread_count()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+bool ThreadPool::pop(std::size_t self, Task &task)
+{
+    for (std::size_t i = 0; i < queues.size(); ++i)
+    {
+        auto &queue = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.head == queue.tasks.size())
+        {
+            continue;
+        }
+
+        // Own work from the front, stolen work from the back
+        if (i == 0)
+        {
+            task = queue.tasks[queue.head++];
+        }
+        else
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        --queued;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::run(const Task &task)
+{
+    (*task.job->body)(task.begin, task.end);
+
+    // The job lives on the stack of parallel_for(), which may return as soon as
+    // it sees the last chunk done. Counting under the lock keeps it around
+    // until this thread is no longer touching it.
+    std::lock_guard<std::mutex> lock(task.job->mutex);
+    if (--task.job->remaining == 0)
+    {
+        task.job->done.notify_all();
+    }
+}
+
+void ThreadPool::worker(std::size_t self)
+{
+    while (true)
+    {
+        Task task;
+        if (pop(self, task))
+        {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [&] { return stopping || queued > 0; });
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent worker threads for data-parallel loops
+//
+// parallel_for() splits its index range into chunks and deals them out to
+// per-thread queues. Each thread works through its own queue from the front
+// and, once that is empty, steals from the back of the others, so uneven
+// chunks still keep every thread busy.
+class ThreadPool
+{
+public:
+    // Loop body, called with a [begin, end) range of indices
+    //
+    // Only refers to the callable it's made from instead of copying it as
+    // std::function would, so that handing a lambda to parallel_for() never
+    // allocates. The callable has to outlive the call.
+    class Body
+    {
+    public:
+        template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Body>::value>>
+        Body(F &&body)
+            : callable(const_cast<void *>(static_cast<const void *>(&body))),
+              call([](void *callable, std::size_t begin, std::size_t end) { (*static_cast<std::remove_reference_t<F> *>(callable))(begin, end); })
+        {
+        }
+
+        void operator()(std::size_t begin, std::size_t end) const { call(callable, begin, end); }
+
+    private:
+        void *callable;
+        void (*call)(void *, std::size_t, std::size_t);
+    };
+
+    // `thread_count` includes the thread calling parallel_for()
+    explicit ThreadPool(std::size_t thread_count = default_thread_count());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t thread_count() const { return queues.size(); }
+
+    // Run `body` over [0, count) in chunks of at most `grain` indices and
+    // return once all of them are done. The calling thread helps out.
+    void parallel_for(std::size_t count, std::size_t grain, const Body &body);
+
+    // One thread per hardware thread
+    static std::size_t default_thread_count();
+
+private:
+    // State of a single parallel_for() call
+    struct Job
+    {
+        const Body *body;
+        std::atomic<std::size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    struct Task
+    {
+        Job *job;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    // Tasks from `head` on are pending. The owner takes them from the front
+    // by advancing `head`, thieves from the back, so the vector keeps its
+    // capacity across jobs.
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        std::size_t head = 0;
+    };
+
+    // Take a task from queue `self`, or steal one from another queue
+    bool pop(std::size_t self, Task &task);
+
+    void run(const Task &task);
+
+    void worker(std::size_t self);
+
+    // One queue per thread, the caller of parallel_for() uses queue 0
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Tasks sitting in queues or about to be, idle workers sleep until this
+    // is nonzero
+    std::atomic<std::size_t> queued{0};
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
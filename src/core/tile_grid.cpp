@@ -0,0 +1,320 @@
+#include "tile_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "distance_kernels.hpp"
+#include "simd.hpp"
+#include "trig_table.hpp"
+
+namespace
+{
+    // Call `tile(tx, ty)` for every tile of `rect`, block by block, and
+    // `block_end()` after every block
+    template <typename Tile, typename BlockEnd>
+    void for_each_tile(const TileGrid::TileRect &rect, Tile &&tile, BlockEnd &&block_end)
+    {
+        const auto b = TileGrid::block_tiles;
+        for (auto bx = rect.x0; bx < rect.x1; bx += b)
+        {
+            for (auto by = rect.y0; by < rect.y1; by += b)
+            {
+                for (auto tx = bx; tx < std::min(bx + b, rect.x1); ++tx)
+                {
+                    for (auto ty = by; ty < std::min(by + b, rect.y1); ++ty)
+                    {
+                        tile(tx, ty);
+                    }
+                }
+                block_end();
+            }
+        }
+    }
+
+    // Bands big enough to amortize scheduling, small enough to balance the load
+    const std::size_t band = 16384;
+
+    // Sun dot product and ShadowRamp of `V::width` tiles from `i`, in 0..255
+    template <typename V>
+    V shade_levels(const TileGrid &grid, const Vec3 &sun, const ShadowRamp &ramp, std::size_t i)
+    {
+        const auto dot = V::load(&grid.cos_lat[i]) * (V::load(&grid.cos_lon[i]) * V::broadcast(sun.x) + V::load(&grid.sin_lon[i]) * V::broadcast(sun.y)) +
+                         V::load(&grid.sin_lat[i]) * V::broadcast(sun.z);
+        const auto shade = min(max(dot * V::broadcast(ramp.scale) + V::broadcast(ramp.offset), V::broadcast(0.f)), V::broadcast(1.f));
+        return round(shade * V::broadcast(255.f));
+    }
+
+    // Margin for float rounding in the per-tile dot products, in radians
+    const auto cap_margin = 1e-5f;
+
+    // Which side of `cutoff` all points between `distance - radius` and
+    // `distance + radius` from the sun are on: -1 closer, 1 further, 0 both
+    int side(float distance, float radius, float cutoff)
+    {
+        if (distance + radius < cutoff)
+        {
+            return -1;
+        }
+        if (distance - radius > cutoff)
+        {
+            return 1;
+        }
+        return 0;
+    }
+}
+
+template <typename Projection>
+void TileGrid::build(float size, float step)
+{
+    const auto n = lattice_side(size, step);
+    build<Projection>(size, step, TileRect{0, 0, n, n});
+}
+
+template <typename Projection>
+void TileGrid::build(float size, float step, TileRect region)
+{
+    const auto n = lattice_side(size, step);
+    region = TileRect{std::max(region.x0, 0), std::max(region.y0, 0), std::min(region.x1, n), std::min(region.y1, n)};
+    region.x1 = std::max(region.x1, region.x0);
+    region.y1 = std::max(region.y1, region.y0);
+
+    this->size = size;
+    this->step = step;
+    this->region = region;
+
+    for (auto *column : {&x, &y, &lat, &lon, &sin_lat, &cos_lat, &sin_lon, &cos_lon})
+    {
+        column->clear();
+    }
+    blocks.clear();
+
+    auto block_begin = count();
+    const auto block_end = [&] {
+        end_block(block_begin);
+        block_begin = count();
+    };
+
+#ifdef FLAT_EARTH_TRIG_TABLE
+    // The default window, see CMakeLists.txt
+    //
+    // Trigonometry is looked up from the TileTrigTable instead of computed.
+    if (std::is_same<Projection, AzimuthalEquidistant>::value && size == 800.f && step == 2.f && region == TileRect{0, 0, n, n})
+    {
+        using Table = TileTrigTable<800, 2>;
+        const auto radius = Table::radius;
+        for_each_tile(
+            region,
+            [&](int tx, int ty) {
+                // Skip tiles outside of the map
+                const auto dx = tx - radius;
+                const auto dy = ty - radius;
+                const auto n = static_cast<std::size_t>(dx * dx + dy * dy);
+                if (n >= Table::entries)
+                {
+                    return;
+                }
+
+                const auto &entry = Table::table[n];
+                x.push_back(static_cast<float>(tx) * step);
+                y.push_back(static_cast<float>(ty) * step);
+                lat.push_back(-entry.r * 180.f + 90.f);
+                lon.push_back(rad2deg(atan2f(-static_cast<float>(dx), static_cast<float>(dy))));
+                sin_lat.push_back(entry.cos_pi_r);
+                cos_lat.push_back(entry.sin_pi_r);
+                sin_lon.push_back(-static_cast<float>(dx) * entry.inv_distance);
+                cos_lon.push_back(n == 0 ? 1.f : static_cast<float>(dy) * entry.inv_distance);
+            },
+            block_end);
+        return;
+    }
+#endif
+
+    const auto radius = size / 2.f;
+    for_each_tile(
+        region,
+        [&](int tx, int ty) {
+            // Skip tiles outside of the map
+            const auto px = static_cast<float>(tx) * step;
+            const auto py = static_cast<float>(ty) * step;
+            LatLon coords;
+            if (!Projection::inverse((Vec2{px, py} - Vec2{radius, radius}) / radius, coords))
+            {
+                return;
+            }
+
+            const auto latr = deg2rad(coords.lat);
+            const auto lonr = deg2rad(coords.lon);
+
+            x.push_back(px);
+            y.push_back(py);
+            lat.push_back(coords.lat);
+            lon.push_back(coords.lon);
+            sin_lat.push_back(sinf(latr));
+            cos_lat.push_back(cosf(latr));
+            sin_lon.push_back(sinf(lonr));
+            cos_lon.push_back(cosf(lonr));
+        },
+        block_end);
+}
+
+template void TileGrid::build<AzimuthalEquidistant>(float, float);
+template void TileGrid::build<Equirectangular>(float, float);
+template void TileGrid::build<Orthographic>(float, float);
+template void TileGrid::build<Mercator>(float, float);
+template void TileGrid::build<AzimuthalEquidistant>(float, float, TileRect);
+template void TileGrid::build<Equirectangular>(float, float, TileRect);
+template void TileGrid::build<Orthographic>(float, float, TileRect);
+template void TileGrid::build<Mercator>(float, float, TileRect);
+
+void TileGrid::end_block(std::size_t begin)
+{
+    const auto end = count();
+    if (begin == end)
+    {
+        return;
+    }
+
+    // Unit vectors of the tiles, see LatLon::to_unit_vector
+    const auto unit = [&](std::size_t i) {
+        return Vec3{cos_lat[i] * cos_lon[i], cos_lat[i] * sin_lon[i], sin_lat[i]};
+    };
+
+    // Normalized mean as the center, any center gives a valid cap
+    double sx = 0., sy = 0., sz = 0.;
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto u = unit(i);
+        sx += u.x;
+        sy += u.y;
+        sz += u.z;
+    }
+    const auto norm = std::sqrt(sx * sx + sy * sy + sz * sz);
+    const auto center = norm > 0. ? Vec3{static_cast<float>(sx / norm), static_cast<float>(sy / norm), static_cast<float>(sz / norm)} : unit(begin);
+
+    auto min_dot = 1.f;
+    for (auto i = begin; i < end; ++i)
+    {
+        min_dot = std::min(min_dot, dot(center, unit(i)));
+    }
+
+    blocks.push_back(Block{begin, end, center, acosf(std::max(min_dot, -1.f)) + cap_margin});
+}
+
+void TileGrid::spherical_distances(const LatLon &origin, std::vector<float> &out) const
+{
+    out.resize(count());
+    spherical_distance_batch(origin, lat.data(), lon.data(), out.data(), count());
+}
+
+void TileGrid::classify(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<Illumination> &out) const
+{
+    out.resize(count());
+    classify(sun.to_unit_vector(), cutoffs, out.data(), 0, count());
+}
+
+void TileGrid::classify(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<Illumination> &out, ThreadPool &pool) const
+{
+    const auto s = sun.to_unit_vector();
+
+    out.resize(count());
+    pool.parallel_for(count(), band, [&](std::size_t begin, std::size_t end) {
+        classify(s, cutoffs, out.data(), begin, end);
+    });
+}
+
+void TileGrid::shade(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<std::uint8_t> &out, ThreadPool &pool) const
+{
+    const auto s = sun.to_unit_vector();
+    const auto ramp = ShadowRamp::from_cutoffs(cutoffs);
+
+    out.resize(count());
+    pool.parallel_for(count(), band, [&](std::size_t begin, std::size_t end) {
+        shade(s, ramp, out.data(), begin, end);
+    });
+}
+
+void TileGrid::classify(const Vec3 &sun, const IlluminationCutoffs &cutoffs, Illumination *out, std::size_t begin, std::size_t end) const
+{
+    for (auto i = begin; i < end; ++i)
+    {
+        // Dot product with the tile's unit vector, see LatLon::to_unit_vector
+        const auto dot = cos_lat[i] * (cos_lon[i] * sun.x + sin_lon[i] * sun.y) + sin_lat[i] * sun.z;
+        out[i] = cutoffs.classify(dot);
+    }
+}
+
+void TileGrid::shade(const Vec3 &sun, const ShadowRamp &ramp, std::uint8_t *out, std::size_t begin, std::size_t end) const
+{
+    auto i = begin;
+    float levels[simd::Wide::width];
+    for (; i + simd::Wide::width <= end; i += simd::Wide::width)
+    {
+        shade_levels<simd::Wide>(*this, sun, ramp, i).store(levels);
+        for (std::size_t lane = 0; lane < simd::Wide::width; ++lane)
+        {
+            out[i + lane] = static_cast<std::uint8_t>(levels[lane]);
+        }
+    }
+    for (; i < end; ++i)
+    {
+        shade_levels<simd::Scalar>(*this, sun, ramp, i).store(levels);
+        out[i] = static_cast<std::uint8_t>(levels[0]);
+    }
+}
+
+void TileGrid::update(const LatLon &sun, const IlluminationCutoffs &cutoffs, IlluminationBuffer &buffer, ThreadPool &pool) const
+{
+    const auto s = sun.to_unit_vector();
+
+    buffer.changed_blocks.resize(blocks.size());
+    if (!buffer.valid || buffer.tiles.size() != count())
+    {
+        classify(sun, cutoffs, buffer.tiles, pool);
+        shade(sun, cutoffs, buffer.shade, pool);
+        std::fill(buffer.changed_blocks.begin(), buffer.changed_blocks.end(), 1);
+        buffer.sun = s;
+        buffer.valid = true;
+        return;
+    }
+
+    const auto previous = buffer.sun;
+    const auto ramp = ShadowRamp::from_cutoffs(cutoffs);
+    const auto angle = [](Vec3 a, Vec3 b) { return acosf(std::min(std::max(dot(a, b), -1.f), 1.f)); };
+
+    pool.parallel_for(blocks.size(), 64, [&](std::size_t begin, std::size_t end) {
+        for (auto b = begin; b < end; ++b)
+        {
+            const auto &block = blocks[b];
+            const auto before = angle(block.center, previous);
+            const auto after = angle(block.center, s);
+
+            // Unchanged if every tile stays on the same side of both cutoffs,
+            // and not between them where the shade depends on the exact angle
+            const auto direct_before = side(before, block.radius, cutoffs.direct_illumination_angle);
+            const auto settled = direct_before != 0 && direct_before == side(before, block.radius, cutoffs.twilight_angle) &&
+                                 direct_before == side(after, block.radius, cutoffs.direct_illumination_angle) &&
+                                 direct_before == side(after, block.radius, cutoffs.twilight_angle);
+
+            buffer.changed_blocks[b] = 0;
+            if (settled)
+            {
+                continue;
+            }
+
+            auto changed = false;
+            for (auto i = block.begin; i < block.end; ++i)
+            {
+                const auto dot = cos_lat[i] * (cos_lon[i] * s.x + sin_lon[i] * s.y) + sin_lat[i] * s.z;
+                const auto illumination = cutoffs.classify(dot);
+                const auto shade = ramp.level(dot);
+                changed |= (illumination != buffer.tiles[i]) | (shade != buffer.shade[i]);
+                buffer.tiles[i] = illumination;
+                buffer.shade[i] = shade;
+            }
+            buffer.changed_blocks[b] = changed;
+        }
+    });
+
+    buffer.sun = s;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "illumination.hpp"
+#include "latlon.hpp"
+#include "projection.hpp"
+#include "thread_pool.hpp"
+
+// Per-tile illumination of a TileGrid, kept between sun positions so that
+// TileGrid::update() can re-evaluate only what changed
+struct IlluminationBuffer
+{
+    std::vector<Illumination> tiles;
+
+    // ShadowRamp level of every tile
+    std::vector<std::uint8_t> shade;
+
+    // Nonzero for the TileGrid blocks whose tiles changed in the last update
+    std::vector<std::uint8_t> changed_blocks;
+
+    // Sun position `tiles` are for, unless the buffer was never filled
+    Vec3 sun{};
+    bool valid = false;
+};
+
+// Illumination tiles that fall on the map, along with everything about them
+// that doesn't depend on the sun position.
+//
+// Kept as a structure of arrays, one entry per tile, so that the per-frame loop
+// walks memory sequentially. Tiles are ordered block by block, so every
+// square block of the map is a contiguous range of them.
+struct TileGrid
+{
+    // Side of a block in tiles
+    static constexpr int block_tiles = 16;
+
+    // Contiguous range of tiles along with a spherical cap bounding their centers
+    struct Block
+    {
+        std::size_t begin;
+        std::size_t end;
+        Vec3 center;
+        // Central angle from `center` to the furthest tile, in radians
+        float radius;
+    };
+
+    // Rectangle of the map's tile lattice, columns [x0, x1) and rows [y0, y1)
+    struct TileRect
+    {
+        int x0, y0, x1, y1;
+
+        bool operator==(const TileRect &other) const { return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1; }
+        bool operator!=(const TileRect &other) const { return !(*this == other); }
+    };
+
+    // Map size and tile size (both in map coordinates) the grid was built for
+    float size = 0.f;
+    float step = 0.f;
+
+    // Part of the lattice the grid covers, all of it unless built for a region
+    TileRect region{};
+
+    // Tile centers in map coordinates
+    std::vector<float> x;
+    std::vector<float> y;
+
+    // Tile coordinates and their trigonometric terms
+    std::vector<float> lat;
+    std::vector<float> lon;
+    std::vector<float> sin_lat;
+    std::vector<float> cos_lat;
+    std::vector<float> sin_lon;
+    std::vector<float> cos_lon;
+
+    std::vector<Block> blocks;
+
+    // Recompute all tiles for a map of the given size split into step-sized
+    // tiles, with the map drawn in `Projection`
+    //
+    // Instantiated for the projections in projection.hpp.
+    template <typename Projection = AzimuthalEquidistant>
+    void build(float size, float step);
+
+    // Same as above, for only the tiles within `region`, clipped to the lattice
+    //
+    // For views zoomed into part of the map, so that the cost follows the
+    // tiles on screen rather than those on the whole map.
+    template <typename Projection = AzimuthalEquidistant>
+    void build(float size, float step, TileRect region);
+
+    // Tiles along each side of the lattice for a map of `size` and tiles of `step`
+    static int lattice_side(float size, float step) { return static_cast<int>(std::ceil(size / step)); }
+
+    // Number of tiles on the map
+    std::size_t count() const { return x.size(); }
+
+    // Distance from `origin` to every tile, see spherical_distance_batch
+    void spherical_distances(const LatLon &origin, std::vector<float> &out) const;
+
+    // Illumination of every tile with the sun directly over `sun`
+    //
+    // Faster than comparing spherical_distances against the cutoffs, as it
+    // only takes a dot product per tile.
+    void classify(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<Illumination> &out) const;
+
+    // Same as above, split into bands of tiles processed by `pool`
+    void classify(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<Illumination> &out, ThreadPool &pool) const;
+
+    // ShadowRamp level of every tile, split into bands processed by `pool`
+    //
+    // Vectorized, the ramp only adds a multiply-add and clamps to the dot product.
+    void shade(const LatLon &sun, const IlluminationCutoffs &cutoffs, std::vector<std::uint8_t> &out, ThreadPool &pool) const;
+
+    // Bring `buffer` to the illumination and shade with the sun over `sun`
+    //
+    // Blocks whose bounding cap lies entirely in daylight or entirely in night
+    // for both the previous and the new sun position can't have changed and are skipped, so
+    // small sun movements only cost the blocks along the old and new
+    // terminator. Falls back to a full classification if the buffer is empty
+    // or was filled for another grid.
+    void update(const LatLon &sun, const IlluminationCutoffs &cutoffs, IlluminationBuffer &buffer, ThreadPool &pool) const;
+
+private:
+    // Close the block started at tile `begin`
+    void end_block(std::size_t begin);
+
+    void classify(const Vec3 &sun, const IlluminationCutoffs &cutoffs, Illumination *out, std::size_t begin, std::size_t end) const;
+    void shade(const Vec3 &sun, const ShadowRamp &ramp, std::uint8_t *out, std::size_t begin, std::size_t end) const;
+};
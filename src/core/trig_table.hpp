@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "latlon.hpp"
+
+// Compile-time evaluable versions of the few math functions the tables need,
+// in double so that the rounded float results match <cmath>
+namespace constexpr_math
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    // Newton's method, starting from `guess` which has to be above the root
+    constexpr double sqrt(double x, double guess)
+    {
+        if (x <= 0.)
+        {
+            return 0.;
+        }
+
+        while (true)
+        {
+            const auto next = (guess + x / guess) / 2.;
+            if (next >= guess)
+            {
+                return guess;
+            }
+            guess = next;
+        }
+    }
+
+    // Taylor series, accurate to double rounding for x in [-π/2, π/2]
+    constexpr double sin(double x)
+    {
+        auto term = x;
+        auto sum = x;
+        for (int n = 1; n < 12; ++n)
+        {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Taylor series, accurate to double rounding for x in [-π/2, π/2]
+    constexpr double cos(double x)
+    {
+        auto term = 1.;
+        auto sum = 1.;
+        for (int n = 1; n < 12; ++n)
+        {
+            term *= -x * x / ((2 * n - 1) * (2 * n));
+            sum += term;
+        }
+        return sum;
+    }
+}
+
+// Trigonometry of the tiles of a `Size`-sized map split into `Step`-sized
+// tiles, generated at compile time.
+//
+// Tile centers are on an integer lattice around the map center, so the squared
+// distance of a tile from it in tile units is an integer, and all per-tile
+// trigonometry in TileGrid::build follows from its entry:
+//
+//   lat = 90° - 180° r    sin(lat) = cos(π r)    cos(lat) = sin(π r)
+//   sin(lon) = -dx / |d|  cos(lon) = dy / |d|
+//
+// Only instantiated for the sizes TileGrid::build looks up, see
+// FLAT_EARTH_TRIG_TABLE.
+template <int Size, int Step>
+struct TileTrigTable
+{
+    static_assert(Size % (2 * Step) == 0, "map center must fall on a tile");
+
+    // Map radius in tiles
+    static constexpr int radius = Size / Step / 2;
+
+    struct Entry
+    {
+        // Tile distance from the map center, 1 at the edge
+        float r;
+        float sin_pi_r;
+        float cos_pi_r;
+        // 1 / |d|, 0 for the center tile
+        float inv_distance;
+    };
+
+    // Squared distances above radius² are off the map
+    static constexpr std::size_t entries = static_cast<std::size_t>(radius) * radius + 1;
+
+    static constexpr std::array<Entry, entries> generate()
+    {
+        std::array<Entry, entries> table{};
+        auto distance = 0.;
+        for (std::size_t n = 0; n < entries; ++n)
+        {
+            // √n is at most one above √(n - 1), a close start for Newton
+            distance = constexpr_math::sqrt(static_cast<double>(n), distance + 1.);
+            const auto r = distance / radius;
+
+            // Keep the Taylor series arguments within [-π/2, π/2]
+            const auto mirrored = r > 0.5;
+            const auto x = constexpr_math::pi * (mirrored ? 1. - r : r);
+            const auto sin_pi_r = constexpr_math::sin(x);
+            const auto cos_pi_r = mirrored ? -constexpr_math::cos(x) : constexpr_math::cos(x);
+
+            table[n] = Entry{
+                static_cast<float>(r),
+                static_cast<float>(sin_pi_r),
+                static_cast<float>(cos_pi_r),
+                n == 0 ? 0.f : static_cast<float>(1. / distance),
+            };
+        }
+        return table;
+    }
+
+    static constexpr std::array<Entry, entries> table = generate();
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+
+// Three slots for handing results from one producer thread to one consumer
+// thread without locks
+//
+// The producer fills back() and publishes it. The consumer picks up the most
+// recently published slot as front(). Which slot plays which role is swapped
+// with a single atomic exchange, so neither side ever waits for the other
+// and the producer can keep going while the consumer still reads its last
+// result.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side
+    T &back() { return slots[back_index]; }
+
+    // Hand back() over to the consumer, taking over the slot it left
+    void publish()
+    {
+        back_index = ready.exchange(back_index | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Consumer side
+    T &front() { return slots[front_index]; }
+
+    // Whether acquire() would get a new slot
+    bool fresh_available() const { return (ready.load(std::memory_order_relaxed) & fresh) != 0; }
+
+    // Make the latest published slot front(), false if nothing was published
+    // since the last call
+    bool acquire()
+    {
+        if (!fresh_available())
+        {
+            return false;
+        }
+        front_index = ready.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    // All slots, only to be touched while the producer is idle
+    T &slot(unsigned index) { return slots[index]; }
+
+    static constexpr unsigned slot_count = 3;
+
+private:
+    static constexpr unsigned index_mask = 3;
+    // Set on the ready index when it holds a slot the consumer hasn't seen
+    static constexpr unsigned fresh = 4;
+
+    T slots[slot_count];
+    unsigned front_index = 0;
+    unsigned back_index = 1;
+    std::atomic<unsigned> ready{2};
+};
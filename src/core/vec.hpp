@@ -0,0 +1,46 @@
+#pragma once
+
+// Minimal vector types, so that the core doesn't depend on SFML's
+
+struct Vec2
+{
+    float x;
+    float y;
+};
+
+inline Vec2 operator+(Vec2 a, Vec2 b)
+{
+    return Vec2{a.x + b.x, a.y + b.y};
+}
+
+inline Vec2 operator-(Vec2 a, Vec2 b)
+{
+    return Vec2{a.x - b.x, a.y - b.y};
+}
+
+inline Vec2 operator*(float s, Vec2 v)
+{
+    return Vec2{s * v.x, s * v.y};
+}
+
+inline Vec2 operator*(Vec2 v, float s)
+{
+    return s * v;
+}
+
+inline Vec2 operator/(Vec2 v, float s)
+{
+    return Vec2{v.x / s, v.y / s};
+}
+
+struct Vec3
+{
+    float x;
+    float y;
+    float z;
+};
+
+inline float dot(Vec3 a, Vec3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
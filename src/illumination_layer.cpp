@@ -0,0 +1,390 @@
+#include "illumination_layer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "sfml_vec.hpp"
+
+namespace
+{
+    // Shadow opacity at night, fading out through twilight along the ShadowRamp
+    const auto night_alpha = 220.f;
+
+    // Outline meridians at most, that's a few pixels each at the highest zoom
+    const std::size_t max_meridians = 16384;
+
+    // Tile grid regions are rounded out to multiples of this many tiles, so
+    // that panning only rebuilds the grid once in a while
+    const auto region_granularity = 2 * TileGrid::block_tiles;
+
+    int round_down(int value, int multiple)
+    {
+        return (value >= 0 ? value : value - multiple + 1) / multiple * multiple;
+    }
+
+    // Passes the untransformed vertex position on, so that the fragment shader
+    // sees the map coordinate of every pixel regardless of window size
+    const char *terminator_vertex_shader = R"(
+varying vec2 position;
+
+void main()
+{
+    position = gl_Vertex.xy;
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+    gl_FrontColor = gl_Color;
+}
+)";
+
+    // Per-pixel version of the Tiles mode, preceded by the projection's inverse
+    const char *terminator_fragment_shader = R"(
+uniform vec2 sun;
+uniform vec2 center;
+uniform float radius;
+uniform float direct_illumination_cutoff;
+uniform float twilight_cutoff;
+uniform float night_alpha;
+
+varying vec2 position;
+
+const float earth_radius_km = 6371.0;
+
+void main()
+{
+    float lat;
+    float lon;
+    if (!inverse((position - center) / radius, lat, lon))
+    {
+        discard;
+    }
+
+    // LatLon::spherical_distance
+    float lat1r = radians(sun.x);
+    float lon1r = radians(sun.y);
+    float lat2r = radians(lat);
+    float lon2r = radians(lon);
+    float u = sin((lat2r - lat1r) / 2.0);
+    float v = sin((lon2r - lon1r) / 2.0);
+    float dist = 2.0 * earth_radius_km * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
+
+    // ShadowRamp, here linear in the distance as that's at hand
+    float shade = clamp((dist - direct_illumination_cutoff) / (twilight_cutoff - direct_illumination_cutoff), 0.0, 1.0);
+    gl_FragColor = vec4(0.0, 0.0, 0.0, shade * night_alpha);
+}
+)";
+}
+
+template <typename Projection>
+bool IlluminationLayer<Projection>::init(float map_size)
+{
+    this->map_size = map_size;
+    terminator_area.setSize(sf::Vector2f(map_size, map_size));
+
+    const auto fragment_shader = std::string(Projection::glsl_inverse()) + terminator_fragment_shader;
+    has_shader = sf::Shader::isAvailable() && terminator.loadFromMemory(terminator_vertex_shader, fragment_shader);
+    if (has_shader)
+    {
+        terminator.setUniform("center", sf::Vector2f(map_size / 2.f, map_size / 2.f));
+        terminator.setUniform("radius", map_size / 2.f);
+        terminator.setUniform("direct_illumination_cutoff", static_cast<float>(direct_illumination_cutoff));
+        terminator.setUniform("twilight_cutoff", static_cast<float>(twilight_cutoff));
+        terminator.setUniform("night_alpha", night_alpha / 255.f);
+    }
+    return has_shader;
+}
+
+template <typename Projection>
+bool IlluminationLayer<Projection>::draw(sf::RenderTarget &target, IlluminationMode mode, const LatLon &sun, float map_pixels, float step, ThreadPool &pool)
+{
+    const auto &view = target.getView();
+    const auto visible = sf::FloatRect(view.getCenter() - view.getSize() / 2.f, view.getSize());
+
+    switch (mode)
+    {
+    case IlluminationMode::Shader:
+        // Fragments outside the view are clipped before the shader runs
+        terminator.setUniform("sun", sf::Vector2f(sun.lat, sun.lon));
+        target.draw(terminator_area, &terminator);
+        return true;
+    case IlluminationMode::Outline:
+        draw_outline(target, sun, map_pixels, visible);
+        return true;
+    case IlluminationMode::Tiles:
+        return draw_tiles(target, sun, step, visible, pool);
+    }
+    return true;
+}
+
+template <typename Projection>
+void IlluminationLayer<Projection>::draw_outline(sf::RenderTarget &target, const LatLon &point, float map_pixels, const sf::FloatRect &visible)
+{
+    // About two pixels of the map rim per meridian
+    const auto rim_px = pi * map_pixels;
+    meridian_shadows(point, cutoffs, std::min(std::max<std::size_t>(360, static_cast<std::size_t>(rim_px / 2.f)), max_meridians), meridians);
+
+    // Every vertex gets the shade of its own point, interpolated in between
+    shadow_outline.clear();
+    const auto radius = map_size / 2.f;
+    const auto sun = point.to_unit_vector();
+    const auto vertex = [&](const MeridianShadow &meridian, float colatitude) {
+        const auto coords = meridian.at(colatitude);
+        const auto alpha = night_alpha * ramp(dot(coords.to_unit_vector(), sun));
+        Vec2 position;
+        Projection::forward(coords, position);
+        return sf::Vertex(sf::Vector2f(radius, radius) + radius * to_sfml(position), sf::Color(0, 0, 0, static_cast<sf::Uint8>(alpha)));
+    };
+
+    // Meridians run from 0 to 360° west, which repeating maps show again one
+    // period to the east
+    const auto min_colatitude = deg2rad(Projection::min_colatitude());
+    const auto max_colatitude = deg2rad(Projection::max_colatitude());
+    const auto period = radius * Projection::period();
+
+    // Bands are clipped to the colatitudes the projection shows, and quads
+    // entirely outside the view are left out
+    const auto band = [&](const MeridianShadow &a, const MeridianShadow &b, float MeridianShadow::*begin, float MeridianShadow::*end) {
+        const auto clip = [&](float colatitude) { return std::min(std::max(colatitude, min_colatitude), max_colatitude); };
+        if (clip(a.*begin) == clip(a.*end) && clip(b.*begin) == clip(b.*end))
+        {
+            return;
+        }
+
+        sf::Vertex corners[] = {vertex(a, clip(a.*begin)), vertex(a, clip(a.*end)), vertex(b, clip(b.*end)), vertex(b, clip(b.*begin))};
+        for (auto copy = 0; copy < (period > 0.f ? 2 : 1); ++copy)
+        {
+            auto min = corners[0].position, max = corners[0].position;
+            for (auto &corner : corners)
+            {
+                corner.position.x += static_cast<float>(copy) * period;
+                min = sf::Vector2f(std::min(min.x, corner.position.x), std::min(min.y, corner.position.y));
+                max = sf::Vector2f(std::max(max.x, corner.position.x), std::max(max.y, corner.position.y));
+            }
+            if (!visible.intersects(sf::FloatRect(min, max - min)) && !visible.contains(min))
+            {
+                continue;
+            }
+            for (const auto i : {0, 1, 3, 1, 2, 3})
+            {
+                shadow_outline.append(corners[i]);
+            }
+        }
+    };
+
+    for (std::size_t i = 0; i + 1 < meridians.size(); ++i)
+    {
+        // The closing copy of the first meridian is taken a turn further, so
+        // that repeating maps don't get a quad spanning all of them
+        const auto &a = meridians[i];
+        auto b = meridians[i + 1];
+        if (b.lon < a.lon)
+        {
+            b.lon += 2.f * pi;
+        }
+        band(a, b, &MeridianShadow::twilight_begin, &MeridianShadow::night_begin);
+        band(a, b, &MeridianShadow::night_begin, &MeridianShadow::night_end);
+        band(a, b, &MeridianShadow::night_end, &MeridianShadow::twilight_end);
+    }
+
+    target.draw(shadow_outline);
+}
+
+template <typename Projection>
+bool IlluminationLayer<Projection>::draw_tiles(sf::RenderTarget &target, const LatLon &sun, float step, const sf::FloatRect &visible, ThreadPool &pool)
+{
+    // Tiles covering the view, with a tile to spare for the texture filtering
+    // at its edges
+    const auto g = region_granularity;
+    const auto region = TileGrid::TileRect{
+        round_down(static_cast<int>(std::floor(visible.left / step)) - 1, g),
+        round_down(static_cast<int>(std::floor(visible.top / step)) - 1, g),
+        round_down(static_cast<int>(std::ceil((visible.left + visible.width) / step)) + 1, g) + g,
+        round_down(static_cast<int>(std::ceil((visible.top + visible.height) / step)) + 1, g) + g,
+    };
+    const auto n = TileGrid::lattice_side(map_size, step);
+    const auto clipped = TileGrid::TileRect{std::max(region.x0, 0), std::max(region.y0, 0), std::min(region.x1, n), std::min(region.y1, n)};
+    if (grid.step != step || grid.region != clipped)
+    {
+        // The background thread reads the grid
+        wait_idle();
+
+        grid.build<Projection>(map_size, step, region);
+        if (grid.count() == 0)
+        {
+            return true;
+        }
+
+        // One texel per tile, centered on the tile, transparent outside the map
+        const auto width = static_cast<unsigned>(grid.region.x1 - grid.region.x0);
+        const auto height = static_cast<unsigned>(grid.region.y1 - grid.region.y0);
+        if (shadow_texture.getSize() != sf::Vector2u(width, height) && !shadow_texture.create(width, height))
+        {
+            std::cerr << "Can't create shadow texture" << std::endl;
+            return false;
+        }
+        shadow_texture.setSmooth(true);
+        shadow_sprite.setTexture(shadow_texture, true);
+        shadow_sprite.setScale(sf::Vector2f(step, step));
+        shadow_sprite.setPosition(sf::Vector2f((static_cast<float>(grid.region.x0) - 0.5f) * step, (static_cast<float>(grid.region.y0) - 0.5f) * step));
+
+        // Every frame starts over, results for the old grid are dropped
+        ++generation;
+        for (unsigned i = 0; i < TripleBuffer<TilesFrame>::slot_count; ++i)
+        {
+            auto &frame = frames.slot(i);
+            frame.illumination.valid = false;
+            frame.pixels.assign(static_cast<std::size_t>(width) * height * 4, 0);
+        }
+
+        // Computed right away, so that a stale grid is never shown
+        auto &frame = frames.front();
+        compute(frame, sun, pool);
+        frame.generation = generation;
+        shadow_texture.update(frame.pixels.data());
+        requested = shown = sun;
+    }
+    if (grid.count() == 0)
+    {
+        return true;
+    }
+
+    if (sun != requested)
+    {
+        request(sun, pool);
+    }
+    if (frames.acquire() && frames.front().generation == generation)
+    {
+        shadow_texture.update(frames.front().pixels.data());
+        if (frames.front().incremental)
+        {
+            compute_ms = frames.front().compute_ms;
+            has_compute_ms = true;
+        }
+        shown = frames.front().sun;
+    }
+
+    target.draw(shadow_sprite);
+    return true;
+}
+
+template <typename Projection>
+bool IlluminationLayer<Projection>::take_tiles_compute_ms(double &ms)
+{
+    ms = compute_ms;
+    const auto taken = has_compute_ms;
+    has_compute_ms = false;
+    return taken;
+}
+
+template <typename Projection>
+void IlluminationLayer<Projection>::compute(TilesFrame &frame, const LatLon &sun, ThreadPool &pool) const
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // Only tiles near the old and new terminator are re-evaluated, unless the
+    // frame is empty
+    auto &illumination = frame.illumination;
+    frame.incremental = illumination.valid;
+    grid.update(sun, cutoffs, illumination, pool);
+
+    const auto texels = static_cast<std::size_t>(grid.region.x1 - grid.region.x0);
+    const auto x0 = static_cast<std::size_t>(grid.region.x0);
+    const auto y0 = static_cast<std::size_t>(grid.region.y0);
+    for (std::size_t b = 0; b < grid.blocks.size(); ++b)
+    {
+        if (!illumination.changed_blocks[b])
+        {
+            continue;
+        }
+
+        // Shadows are black, only the opacity follows the shade
+        const auto &block = grid.blocks[b];
+        for (auto i = block.begin; i < block.end; ++i)
+        {
+            const auto tx = static_cast<std::size_t>(std::lround(grid.x[i] / grid.step)) - x0;
+            const auto ty = static_cast<std::size_t>(std::lround(grid.y[i] / grid.step)) - y0;
+            frame.pixels[(ty * texels + tx) * 4 + 3] = static_cast<sf::Uint8>(night_alpha * illumination.shade[i] / 255.f);
+        }
+    }
+
+    frame.sun = sun;
+    frame.compute_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Projection>
+void IlluminationLayer<Projection>::request(const LatLon &sun, ThreadPool &pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request_sun = sun;
+        request_generation = generation;
+        request_pool = &pool;
+        has_request = true;
+    }
+    wake.notify_one();
+    requested = sun;
+
+    if (!worker.joinable())
+    {
+        worker = std::thread(&IlluminationLayer::work, this);
+    }
+}
+
+template <typename Projection>
+void IlluminationLayer<Projection>::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    has_request = false;
+    idle.wait(lock, [&] { return !busy; });
+}
+
+template <typename Projection>
+void IlluminationLayer<Projection>::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&] { return stopping || has_request; });
+        if (stopping)
+        {
+            return;
+        }
+
+        const auto sun = request_sun;
+        const auto frame_generation = request_generation;
+        auto &pool = *request_pool;
+        has_request = false;
+        busy = true;
+        lock.unlock();
+
+        auto &frame = frames.back();
+        compute(frame, sun, pool);
+        frame.generation = frame_generation;
+        frames.publish();
+
+        lock.lock();
+        busy = false;
+        idle.notify_all();
+    }
+}
+
+template <typename Projection>
+IlluminationLayer<Projection>::~IlluminationLayer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+template class IlluminationLayer<AzimuthalEquidistant>;
+template class IlluminationLayer<Equirectangular>;
+template class IlluminationLayer<Orthographic>;
+template class IlluminationLayer<Mercator>;
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "illumination.hpp"
+#include "latlon.hpp"
+#include "projection.hpp"
+#include "terminator.hpp"
+#include "thread_pool.hpp"
+#include "tile_grid.hpp"
+#include "triple_buffer.hpp"
+
+// Ways of computing the illumination overlay, cycled through with M
+enum class IlluminationMode
+{
+    // Per pixel on the GPU
+    Shader,
+    // Analytic shadow outline, see meridian_shadows
+    Outline,
+    // Per tile on the CPU
+    Tiles,
+};
+
+// Night side shadow over the map, in any of the IlluminationModes
+//
+// Owns every buffer the modes draw from: vertices, the tile grid with its
+// illumination, and the shadow texture. They keep their capacity from frame
+// to frame, so once each mode has been drawn at the current resolution,
+// drawing it again doesn't allocate.
+//
+// The Tiles mode computes on a background thread: a new sun position is
+// handed to it and drawn once done, in the meantime the last result stays
+// up. Results come back through a TripleBuffer, so the two threads never
+// wait on each other. Only a new grid, after the view or resolution
+// changed, is computed while drawing.
+//
+// The map is drawn in `Projection`, instantiated for the projections in
+// projection.hpp. The shader is generated with its inverse.
+template <typename Projection>
+class IlluminationLayer
+{
+public:
+    // Set up for a `map_size`x`map_size` map at the origin, false if the
+    // Shader mode is unavailable. Needs an active OpenGL context.
+    bool init(float map_size);
+
+    IlluminationLayer() = default;
+    ~IlluminationLayer();
+
+    IlluminationLayer(const IlluminationLayer &) = delete;
+    IlluminationLayer &operator=(const IlluminationLayer &) = delete;
+
+    bool shader_available() const { return has_shader; }
+
+    // Whether the background thread has a Tiles result the last draw didn't
+    // have yet, so that it's worth drawing again
+    bool tiles_ready() const { return frames.fresh_available(); }
+
+    // Whether the sun position last drawn in the Tiles mode is still being
+    // computed, so that the result is worth waiting for
+    bool tiles_pending() const { return shown != requested; }
+
+    // Milliseconds the last drawn Tiles result took to update, false if
+    // there's no result since the last call
+    //
+    // Only covers steady-state incremental updates on the background thread.
+    // Grid construction and full classifications are left out: the frame
+    // computed right after a rebuild, and the first result of every other
+    // slot, which starts out empty. They cost several times more per tile,
+    // and would swing the resolution into another rebuild.
+    bool take_tiles_compute_ms(double &ms);
+
+    // Draw the shadow for the sun at `sun` with the target's current view
+    //
+    // Only what falls within the view is evaluated. `map_pixels` is the size
+    // of the whole map on screen, used for the detail of the outline, and
+    // `step` the tile size of the Tiles mode in map units. False if the
+    // shadow texture can't be created.
+    bool draw(sf::RenderTarget &target, IlluminationMode mode, const LatLon &sun, float map_pixels, float step, ThreadPool &pool);
+
+private:
+    // Illumination of the grid for one sun position and the texels showing it
+    struct TilesFrame
+    {
+        IlluminationBuffer illumination;
+        std::vector<sf::Uint8> pixels;
+        LatLon sun{};
+        // Grid the frame was computed for, counting rebuilds
+        std::size_t generation = 0;
+        double compute_ms = 0.;
+        // Whether the update was incremental rather than a full classification
+        bool incremental = false;
+    };
+
+    void draw_outline(sf::RenderTarget &target, const LatLon &sun, float map_pixels, const sf::FloatRect &visible);
+    bool draw_tiles(sf::RenderTarget &target, const LatLon &sun, float step, const sf::FloatRect &visible, ThreadPool &pool);
+
+    // Bring `frame` to the sun at `sun`, rewriting the texels of changed blocks
+    void compute(TilesFrame &frame, const LatLon &sun, ThreadPool &pool) const;
+
+    // Have the background thread compute `sun` next, replacing any request it
+    // hasn't started on
+    void request(const LatLon &sun, ThreadPool &pool);
+
+    // Drop any pending request and wait until the background thread is idle
+    void wait_idle();
+
+    void work();
+
+    float map_size = 0.f;
+    IlluminationCutoffs cutoffs = IlluminationCutoffs::standard();
+    ShadowRamp ramp = ShadowRamp::from_cutoffs(cutoffs);
+
+    // GPU illumination on a full map quad
+    sf::Shader terminator;
+    bool has_shader = false;
+    sf::RectangleShape terminator_area;
+
+    // Shadow outline, one quad per meridian and illumination band
+    sf::VertexArray shadow_outline{sf::Triangles};
+    std::vector<MeridianShadow> meridians;
+
+    // Illumination tiles as the texels of a small texture, upscaled with
+    // bilinear filtering so that the twilight bands blend smoothly. Every
+    // frame rewrites only the texels of the grid blocks that changed since it
+    // was last computed. The grid covers the view and is rebuilt when the
+    // view leaves it.
+    TileGrid grid;
+    std::size_t generation = 0;
+    TripleBuffer<TilesFrame> frames;
+    sf::Texture shadow_texture;
+    sf::Sprite shadow_sprite;
+
+    // Sun position last handed to the background thread, and the one the
+    // shadow texture shows
+    LatLon requested{};
+    LatLon shown{};
+    double compute_ms = 0.;
+    bool has_compute_ms = false;
+
+    // Background thread and its request, guarded by `mutex`
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool has_request = false;
+    bool busy = false;
+    bool stopping = false;
+    LatLon request_sun{};
+    std::size_t request_generation = 0;
+    ThreadPool *request_pool = nullptr;
+};
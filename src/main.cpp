@@ -1,86 +1,207 @@
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include <SFML/Graphics.hpp>
 
-// This function converts decimal degrees to radians
-float deg2rad(float deg)
-{
-    return (deg * M_PI / 180);
-}
+#include "adaptive_resolution.hpp"
+#include "allocation_counter.hpp"
+#include "illumination_layer.hpp"
+#include "latlon.hpp"
+#include "map_pyramid.hpp"
+#include "place_layer.hpp"
+#include "places.hpp"
+#include "projection.hpp"
+#include "profiler.hpp"
+#include "profiler_overlay.hpp"
+#include "sfml_vec.hpp"
+#include "solar.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
+
+// Side of the map in map units, the view shows it whole when not zoomed in
+const auto map_size = 800.f;
+const auto map_radius = map_size / 2.f;
+const auto map_center = sf::Vector2f(map_radius, map_radius);
 
-//  This function converts radians to decimal degrees
-float rad2deg(float rad)
+// Position of `coords` on the map, drawn in `Projection`
+template <typename Projection>
+sf::Vector2f map_position(const LatLon &coords)
 {
-    return (rad * 180 / M_PI);
+    Vec2 position;
+    Projection::forward(coords, position);
+    return map_center + map_radius * to_sfml(position);
 }
 
-// Latitude-Longitude coordinates
-struct LatLon
+// `source`, the azimuthal equidistant map, redrawn in `Projection` over its
+// extent at the same resolution. Pixels off the projection are transparent.
+template <typename Projection>
+void resample_map(const sf::Image &source, sf::Image &out, ThreadPool &pool)
 {
-    // 90° at north pole, -90° at south pole
-    float lat;
-    // 0° through London, ±180 at the other side, positive goes west
-    float lon;
+    const auto source_size = source.getSize();
+    const auto extent = Projection::extent();
+    const auto width = std::max(1u, static_cast<unsigned>(std::lround(source_size.x * extent.x)));
+    const auto height = std::max(1u, static_cast<unsigned>(std::lround(source_size.y * extent.y)));
+    const auto *source_pixels = source.getPixelsPtr();
+    std::vector<sf::Uint8> pixels(static_cast<std::size_t>(width) * height * 4, 0);
 
-    // Compute the length of the path between two points along a great circle.
-    //
-    // https://en.wikipedia.org/wiki/Haversine_formula
-    float spherical_distance(const LatLon &other) const
-    {
-        const auto earth_radius_km = 6371.f;
+    pool.parallel_for(height, 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; ++y)
+        {
+            for (auto x = std::size_t{0}; x < width; ++x)
+            {
+                const auto coords = Vec2{(2.f * (x + 0.5f) / width - 1.f) * extent.x, (2.f * (y + 0.5f) / height - 1.f) * extent.y};
+                LatLon lat_lon;
+                Vec2 position;
+                if (!Projection::inverse(coords, lat_lon) || !AzimuthalEquidistant::forward(lat_lon, position))
+                {
+                    continue;
+                }
 
-        const auto lat1r = deg2rad(lat);
-        const auto lon1r = deg2rad(lon);
-        const auto lat2r = deg2rad(other.lat);
-        const auto lon2r = deg2rad(other.lon);
-        const auto u = sinf((lat2r - lat1r) / 2);
-        const auto v = sinf((lon2r - lon1r) / 2);
+                // Bilinear sample around the source pixel, clamped to the edges
+                const auto sx = (position.x + 1.f) / 2.f * source_size.x - 0.5f;
+                const auto sy = (position.y + 1.f) / 2.f * source_size.y - 0.5f;
+                const auto fx = std::floor(sx);
+                const auto fy = std::floor(sy);
+                const auto clamp_x = [&](float v) { return static_cast<std::size_t>(std::min(std::max(v, 0.f), source_size.x - 1.f)); };
+                const auto clamp_y = [&](float v) { return static_cast<std::size_t>(std::min(std::max(v, 0.f), source_size.y - 1.f)); };
+                const std::size_t xs[] = {clamp_x(fx), clamp_x(fx + 1.f)};
+                const std::size_t ys[] = {clamp_y(fy), clamp_y(fy + 1.f)};
+                const float wx[] = {1.f - (sx - fx), sx - fx};
+                const float wy[] = {1.f - (sy - fy), sy - fy};
 
-        return 2.0 * earth_radius_km * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
-    }
+                auto *pixel = &pixels[(y * width + x) * 4];
+                for (auto channel = 0; channel < 4; ++channel)
+                {
+                    auto value = 0.f;
+                    for (auto j = 0; j < 2; ++j)
+                    {
+                        for (auto i = 0; i < 2; ++i)
+                        {
+                            value += wx[i] * wy[j] * source_pixels[(ys[j] * source_size.x + xs[i]) * 4 + channel];
+                        }
+                    }
+                    pixel[channel] = static_cast<sf::Uint8>(std::lround(std::min(value, 255.f)));
+                }
+            }
+        }
+    });
+
+    out.create(width, height, pixels.data());
+}
+
+// Command line options
+struct Options
+{
+    std::size_t threads = ThreadPool::default_thread_count();
+    std::string profile_csv;
+    std::string font;
+    std::string map_tiles;
+    std::string places_file;
+    std::string projection = AzimuthalEquidistant::name();
+    unsigned illumination_resolution = 400;
+    double target_frame_ms = 0.;
+    bool realtime = false;
+    bool event_driven = false;
+    unsigned max_fps = 60;
+    bool vsync = false;
+    bool has_time = false;
+    std::int64_t time = 0;
+};
+
+// The viewer, with the map drawn in `Projection`
+template <typename Projection>
+int run(const Options &options)
+{
+    // Toggled with T
+    auto realtime = options.realtime;
 
-    // Map to x-y representation on the azimuthal equidistant projection
-    sf::Vector2f to_azimuthal_equidistant() const
+    // Frame timings, shown with P and optionally logged for offline analysis
+    FrameProfiler profiler;
+    if (!options.profile_csv.empty() && !profiler.open_csv(options.profile_csv))
     {
-        const auto r = -(lat - 90.f) / 180.f;
-        const auto th = deg2rad(lon);
-        return r * sf::Vector2f(-sin(th), cos(th));
+        std::cerr << "Can't open " << options.profile_csv << std::endl;
+        return 1;
     }
 
-    // Compute LatLon from x-y azimuthal equidistant projection coordinates
-    static LatLon from_azimuthal_equidistant(sf::Vector2f coords)
+    ProfilerOverlay profiler_overlay;
+    if (!options.font.empty() && !profiler_overlay.load_font(options.font))
     {
-        const auto r = sqrtf(coords.x * coords.x + coords.y * coords.y);
-        const auto th = atan2f(-coords.x, coords.y);
+        std::cerr << "Can't load " << options.font << ", profiler stats go to the window title" << std::endl;
+    }
+    auto show_profiler = false;
 
-        const auto lat = -r * 180.f + 90.f;
-        const auto lon = rad2deg(th);
+    // Workers for the CPU illumination path
+    ThreadPool pool(options.threads);
 
-        return LatLon{lat, lon};
-    }
-};
+    sf::RenderWindow window(sf::VideoMode(static_cast<unsigned>(map_size), static_cast<unsigned>(map_size)), "Flat Earth");
+    window.setVerticalSyncEnabled(options.vsync);
 
-int main()
-{
-    sf::RenderWindow window(sf::VideoMode(800, 800), "Flat Earth");
+    // With --event-driven frames are only drawn when something changed, at
+    // most --max-fps of them a second while input keeps coming, as when
+    // dragging the sun around. In between the loop sleeps in waitEvent(), or
+    // polls every few milliseconds while a real-time tick or a background
+    // Tiles result is due.
+    const auto frame_interval = sf::seconds(1.f / static_cast<float>(options.max_fps));
+    const auto idle_poll = sf::milliseconds(10);
+    sf::Clock frame_clock;
 
-    // Load world map texture
-    sf::Texture texture;
-    if (!texture.loadFromFile("../../map.jpg"))
+    // World map, either as a FlatEarthMapTiles pyramid or the whole map image
+    // of the projection, covering the projection's extent
+    const auto map_extent = map_radius * to_sfml(Projection::extent());
+    MapPyramid map_pyramid;
+    const auto use_pyramid = !options.map_tiles.empty();
+    if (use_pyramid && !map_pyramid.open(options.map_tiles))
     {
-        std::cerr << "Can't load map.jpg" << std::endl;
+        std::cerr << "Can't open map pyramid in " << options.map_tiles << std::endl;
         return 1;
     }
-    texture.setSmooth(true);
 
-    // World map sprite
+    // Whole map sprite, scaled to the map size
+    sf::Texture texture;
     sf::Sprite world_map;
-    world_map.setTexture(texture);
-    world_map.setScale(sf::Vector2f(800. / 2058, 800. / 2058));
+    if (!use_pyramid)
+    {
+        // Only the azimuthal equidistant map ships with the repo, the others
+        // are resampled from it. Either way the decoded pixels are cached next
+        // to the binary for faster startup, in the working directory if its
+        // location is unknown.
+        const std::string source = std::string("../../") + AzimuthalEquidistant::map_file();
+        const auto cache = executable_directory() + Projection::map_file() + ".rgba";
+        const auto loaded = std::is_same<Projection, AzimuthalEquidistant>::value
+                                ? load_texture_cached(texture, source, cache)
+                                : load_texture_cached(texture, source, cache, [&](const sf::Image &map, sf::Image &out) {
+                                      resample_map<Projection>(map, out, pool);
+                                  });
+        if (!loaded)
+        {
+            std::cerr << "Can't load " << source << ", pass --map-tiles to use a FlatEarthMapTiles pyramid instead" << std::endl;
+            return 1;
+        }
+
+        texture.setSmooth(true);
+        texture.generateMipmap();
 
-    // Washington (because why not)
-    auto point = LatLon{47.7511, 120.7401};
+        world_map.setTexture(texture);
+        world_map.setPosition(map_center - map_extent);
+        world_map.setScale(sf::Vector2f(2.f * map_extent.x / texture.getSize().x, 2.f * map_extent.y / texture.getSize().y));
+    }
+
+    // Washington (because why not), unless a time was given
+    auto point = options.has_time ? subsolar_point(static_cast<double>(options.time)) : LatLon{47.7511, 120.7401};
+
+    // In real-time mode (toggled with T) the sun follows the system clock. It
+    // moves ~0.25° per minute, so the subsolar point is only recomputed once a
+    // second and only moved once that's at least one tile on the map.
+    const auto realtime_interval = sf::seconds(1.f);
+    sf::Clock realtime_clock;
+    auto realtime_due = true;
 
     // Sun position marker
     //
@@ -89,92 +210,466 @@ int main()
     marker.setOrigin(sf::Vector2f(10, 10));
     marker.setFillColor(sf::Color(220, 220, 30));
 
-    // Cities to mark on map
-    const LatLon cities[] = {LatLon{-33.9249, -18.4241}, LatLon{-34.6037, 58.3816}, LatLon{-33.8688, -151.2093}};
-    sf::CircleShape city(4);
-    city.setOrigin(sf::Vector2f(4, 4));
-    city.setFillColor(sf::Color(220, 30, 30));
+    // Places to mark on map, a few cities unless loaded from --places
+    std::vector<Place> places = {
+        Place{"Cape Town", LatLon{-33.9249, -18.4241}},
+        Place{"Buenos Aires", LatLon{-34.6037, 58.3816}},
+        Place{"Sydney", LatLon{-33.8688, -151.2093}},
+    };
+    std::size_t places_error = 0;
+    if (!options.places_file.empty() && !load_places(options.places_file, places, places_error))
+    {
+        std::cerr << "Can't load " << options.places_file << (places_error ? ", bad line " + std::to_string(places_error) : "") << std::endl;
+        return 1;
+    }
+    PlaceLayer place_layer;
+    place_layer.set<Projection>(std::move(places), map_size);
+
+    // Name of the place under the mouse, drawn if a font was given and in the title otherwise
+    sf::Font label_font;
+    const auto has_label_font = !options.font.empty() && label_font.loadFromFile(options.font);
+    auto hovered = PlaceLayer::none;
+    std::string hovered_label;
+    std::vector<SphereIndex::Hit> nearby;
+    sf::Text label("", label_font, 14);
+    label.setFillColor(sf::Color::White);
+    label.setOutlineColor(sf::Color::Black);
+    label.setOutlineThickness(1.f);
+
+    // Illumination overlay, on the GPU by default if shaders are supported.
+    // The resolution of the Tiles mode, in tiles across the map, is
+    // independent of the window and adapts to --target-frame-ms if given.
+    IlluminationLayer<Projection> illumination;
+    auto mode = illumination.init(map_size) ? IlluminationMode::Shader : IlluminationMode::Outline;
+    if (!illumination.shader_available())
+    {
+        std::cerr << "Shaders unavailable, computing illumination on the CPU" << std::endl;
+    }
+    AdaptiveResolution resolution(options.illumination_resolution, 64);
+
+    // World map with illumination on top, only redrawn when the sun moves, the
+    // window is resized or the render mode changes
+    sf::RenderTexture overlay;
+    auto overlay_dirty = true;
+    auto overlay_point = point;
+
+    // View of the map in the window and a plain pixel view to blit the overlay with
+    auto map_view = window.getView();
+    auto pixel_view = window.getView();
+
+    // Zoomed with the mouse wheel and panned by dragging, zoom 1 fits the
+    // whole map into the window
+    const auto max_zoom = 64.f;
+    auto zoom = 1.f;
+    auto view_center = map_center;
+    auto dragging = false;
+    auto drag_from = sf::Vector2i();
+    const auto update_view = [&] {
+        const auto window_size = window.getSize();
+        const auto width = static_cast<float>(window_size.x);
+        const auto height = static_cast<float>(window_size.y);
+        const auto scale = map_size / std::min(width, height) / zoom;
+
+        // Keep the view center on the map
+        view_center = sf::Vector2f(std::min(std::max(view_center.x, 0.f), map_size), std::min(std::max(view_center.y, 0.f), map_size));
+        map_view = sf::View(view_center, sf::Vector2f(width * scale, height * scale));
+        pixel_view = sf::View(sf::FloatRect(0, 0, width, height));
+        window.setView(map_view);
+        overlay_dirty = true;
+    };
+
+    // Map units per window pixel
+    const auto map_pixel = [&] { return map_view.getSize().y / static_cast<float>(window.getSize().y); };
+
+    // Frames are checked for heap allocations in FLAT_EARTH_COUNT_ALLOCATIONS builds
+    std::size_t frame = 0;
+
     while (window.isOpen())
     {
-        // Stop app if window is closed
+        // Sleep until there's input or something else to draw, outside of
+        // the frame so that idle time isn't profiled
         sf::Event event;
-        while (window.pollEvent(event))
+        auto waited = false;
+        if (options.event_driven)
         {
-            if (event.type == sf::Event::Closed)
+            const auto elapsed = frame_clock.getElapsedTime();
+            if (elapsed < frame_interval)
+            {
+                sf::sleep(frame_interval - elapsed);
+            }
+
+            const auto tiles_due = [&] { return mode == IlluminationMode::Tiles && illumination.tiles_pending(); };
+            if (!overlay_dirty && !realtime && !tiles_due())
+            {
+                waited = window.waitEvent(event);
+            }
+            else if (!overlay_dirty)
             {
-                window.close();
+                while (!(waited = window.pollEvent(event)) && !(realtime && realtime_clock.getElapsedTime() >= realtime_interval) &&
+                       !(tiles_due() && illumination.tiles_ready()))
+                {
+                    sf::sleep(idle_poll);
+                }
             }
+            frame_clock.restart();
         }
 
-        // Clear and overlay world map
-        window.clear(sf::Color::Black);
-        window.draw(world_map);
+        profiler.begin_frame();
+        const auto frame_allocations = allocation_count();
 
-        // Put sun at mouse position if space is pressed
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
         {
-            const auto pixel = sf::Mouse::getPosition(window);
-            const auto coord = window.mapPixelToCoords(pixel);
+            FrameProfiler::Scope timer(profiler, FrameProfiler::Events);
 
-            point = LatLon::from_azimuthal_equidistant((coord - sf::Vector2f(400, 400)) / 400.f);
-        }
+            // Stop app if window is closed, starting with the event waited for
+            for (auto has_event = waited || window.pollEvent(event); has_event; has_event = window.pollEvent(event))
+            {
+                if (event.type == sf::Event::Closed)
+                {
+                    window.close();
+                }
 
-        // Render illumination
-        // 1px-wide rectangle for illumination computation
-        auto step = 2.f;
-        sf::RectangleShape tile(sf::Vector2f(step, step));
-        tile.setOrigin(sf::Vector2f(step / 2.f, step / 2.f));
+                // Keep the map square in the resized window
+                if (event.type == sf::Event::Resized)
+                {
+                    update_view();
+                    place_layer.invalidate();
+                }
 
-        for (float x = 0.f; x < 800.f; x += step)
-        {
-            for (float y = 0.f; y < 800.f; y += step)
+                // Zoom with the mouse wheel, keeping the point under the mouse in place
+                if (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
+                {
+                    const auto mouse = sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+                    const auto before = window.mapPixelToCoords(mouse, map_view);
+                    zoom = std::min(std::max(zoom * std::pow(1.25f, event.mouseWheelScroll.delta), 1.f), max_zoom);
+                    update_view();
+                    view_center += before - window.mapPixelToCoords(mouse, map_view);
+                    update_view();
+                }
+
+                // Pan by dragging with the left mouse button
+                if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+                {
+                    dragging = true;
+                    drag_from = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+                }
+                if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+                {
+                    dragging = false;
+                }
+                if (event.type == sf::Event::MouseMoved && dragging)
+                {
+                    const auto mouse = sf::Vector2i(event.mouseMove.x, event.mouseMove.y);
+                    view_center += window.mapPixelToCoords(drag_from, map_view) - window.mapPixelToCoords(mouse, map_view);
+                    drag_from = mouse;
+                    update_view();
+                }
+
+                // Look up the place under the mouse, within a few pixels
+                if (event.type == sf::Event::MouseMoved)
+                {
+                    const auto coord = window.mapPixelToCoords(sf::Vector2i(event.mouseMove.x, event.mouseMove.y), map_view);
+                    const auto found = place_layer.find(coord, 6.f * map_pixel());
+                    if (found != hovered)
+                    {
+                        hovered = found;
+                        place_layer.set_hovered(hovered);
+
+                        // Name, and the closest other place with its distance
+                        hovered_label.clear();
+                        if (hovered != PlaceLayer::none)
+                        {
+                            const auto &place = place_layer.place(hovered);
+                            hovered_label = place.name;
+                            place_layer.spherical_index().nearest(place.coords, 2, nearby);
+                            for (const auto &hit : nearby)
+                            {
+                                if (hit.index != hovered)
+                                {
+                                    hovered_label += " (" + std::to_string(static_cast<int>(std::lround(hit.distance))) + " km from " + place_layer.place(hit.index).name + ")";
+                                    break;
+                                }
+                            }
+                        }
+                        if (has_label_font)
+                        {
+                            label.setString(hovered_label);
+                        }
+                        else
+                        {
+                            window.setTitle(hovered == PlaceLayer::none ? "Flat Earth" : "Flat Earth - " + hovered_label);
+                        }
+                    }
+                }
+
+                // Cycle through the illumination modes with M
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::M)
+                {
+                    switch (mode)
+                    {
+                    case IlluminationMode::Shader:
+                        mode = IlluminationMode::Outline;
+                        break;
+                    case IlluminationMode::Outline:
+                        mode = IlluminationMode::Tiles;
+                        break;
+                    case IlluminationMode::Tiles:
+                        mode = illumination.shader_available() ? IlluminationMode::Shader : IlluminationMode::Outline;
+                        break;
+                    }
+                    overlay_dirty = true;
+                }
+
+                // Toggle real-time mode with T
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::T)
+                {
+                    realtime = !realtime;
+                    realtime_due = true;
+                }
+
+                // Toggle the profiler overlay with P
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+                {
+                    show_profiler = !show_profiler;
+                    if (!show_profiler)
+                    {
+                        window.setTitle("Flat Earth");
+                    }
+                }
+            }
+
+            // Put sun at mouse position if space is pressed
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
             {
-                // LatLon coordinate of the given 1px tile
-                const auto tile_coords = LatLon::from_azimuthal_equidistant((sf::Vector2f(x, y) - sf::Vector2f(400, 400)) / 400.f);
-                if (tile_coords.lat < -90.)
+                const auto pixel = sf::Mouse::getPosition(window);
+                const auto coord = window.mapPixelToCoords(pixel, map_view);
+
+                LatLon coords;
+                if (Projection::inverse(from_sfml((coord - map_center) / map_radius), coords))
                 {
-                    continue;
+                    point = coords;
+                    realtime = false;
                 }
+            }
+
+            if (realtime && (realtime_due || realtime_clock.getElapsedTime() >= realtime_interval))
+            {
+                realtime_clock.restart();
 
-                // Don't put the shadow if the point is outside of the map or the distance from marker is more than 1/4 of earth circumference
-                const auto earth_cicumference_km = 40075.;
-                const auto direct_illumination_cutoff = (earth_cicumference_km / 2.f) * 0.50139f;
-                const auto twilight_cutoff = direct_illumination_cutoff + earth_cicumference_km * (6. / 360.);
+                const auto now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+                const auto sun = subsolar_point(now);
 
-                const auto distance = point.spherical_distance(tile_coords);
-                if (distance < direct_illumination_cutoff)
+                // Map units per rendered tile or pixel, 180° of latitude per map radius
+                const auto pixel = map_pixel();
+                const auto tile = mode == IlluminationMode::Tiles ? std::max(map_size / resolution.get() / zoom, pixel) : pixel;
+                const auto tile_km = deg2rad(tile * 180.f / map_radius) * earth_radius_km;
+
+                if (realtime_due || point.spherical_distance(sun) >= tile_km)
                 {
-                    continue;
+                    point = sun;
                 }
+                realtime_due = false;
+            }
+        }
+
+        if (point != overlay_point)
+        {
+            overlay_point = point;
+            overlay_dirty = true;
+        }
+
+        // A Tiles result computed in the background since the last redraw
+        if (mode == IlluminationMode::Tiles && illumination.tiles_ready())
+        {
+            overlay_dirty = true;
+        }
 
-                if (distance > twilight_cutoff)
+        if (overlay_dirty)
+        {
+            const auto window_size = window.getSize();
+            if (overlay.getSize() != window_size && !overlay.create(window_size.x, window_size.y))
+            {
+                std::cerr << "Can't create overlay render texture" << std::endl;
+                return 1;
+            }
+            overlay.setView(map_view);
+
+            // Clear and overlay world map
+            {
+                FrameProfiler::Scope timer(profiler, FrameProfiler::MapDraw);
+                overlay.clear(sf::Color::Black);
+                if (use_pyramid)
                 {
-                    tile.setFillColor(sf::Color(0, 0, 0, 220));
+                    const auto visible = sf::FloatRect(map_view.getCenter() - map_view.getSize() / 2.f, map_view.getSize());
+                    map_pyramid.draw(overlay, map_center - map_extent, 2.f * map_extent.x, 1.f / map_pixel(), visible);
                 }
                 else
                 {
-                    tile.setFillColor(sf::Color(0, 0, 0, 110));
+                    overlay.draw(world_map);
                 }
+            }
 
-                // reposition & draw tile
-                tile.setPosition(sf::Vector2f(x, y));
-                window.draw(tile);
+            // Render illumination
+            {
+                FrameProfiler::Scope timer(profiler, FrameProfiler::Illumination);
+
+                // Tiles keep their size on screen at any zoom, so only those in view are computed
+                const auto map_pixels = map_size / map_pixel();
+                if (!illumination.draw(overlay, mode, point, map_pixels, map_size / resolution.get() / zoom, pool))
+                {
+                    return 1;
+                }
+
+                // Keep the tile update, computed in the background, within what
+                // the rest of the frame leaves of the target. Each update is
+                // taken into account once.
+                auto compute_ms = 0.;
+                if (mode == IlluminationMode::Tiles && options.target_frame_ms > 0. && illumination.take_tiles_compute_ms(compute_ms))
+                {
+                    auto budget_ms = options.target_frame_ms;
+                    for (const auto stage : {FrameProfiler::Events, FrameProfiler::MapDraw, FrameProfiler::Markers, FrameProfiler::Display})
+                    {
+                        budget_ms -= profiler.stage_mean(stage);
+                    }
+                    resolution.update(compute_ms, std::max(budget_ms, 1.), std::min(window_size.x, window_size.y));
+                }
             }
+
+            overlay.display();
+            overlay_dirty = false;
+        }
+
+        {
+            FrameProfiler::Scope timer(profiler, FrameProfiler::MapDraw);
+            window.clear(sf::Color::Black);
+            window.setView(pixel_view);
+            window.draw(sf::Sprite(overlay.getTexture()));
+            window.setView(map_view);
         }
 
-        // Put the marker showing where the sun is directly overhead
-        marker.setPosition(sf::Vector2f(400, 400) + 400.f * point.to_azimuthal_equidistant());
-        window.draw(marker);
+        {
+            FrameProfiler::Scope timer(profiler, FrameProfiler::Markers);
+
+            // Put the marker showing where the sun is directly overhead, at a
+            // constant size on screen
+            marker.setPosition(map_position<Projection>(point));
+            marker.setScale(map_pixel(), map_pixel());
+            window.draw(marker);
+
+            // Put markers at the places, with the hovered one labeled
+            place_layer.draw(window, map_pixel());
+
+            if (hovered != PlaceLayer::none && has_label_font)
+            {
+                const auto &place = place_layer.place(hovered);
+                const auto anchor = sf::Vector2f(window.mapCoordsToPixel(map_position<Projection>(place.coords), map_view));
+                label.setPosition(anchor + sf::Vector2f(10.f, -8.f));
+                window.setView(pixel_view);
+                window.draw(label);
+                window.setView(map_view);
+            }
+        }
+
+        if (show_profiler)
+        {
+            window.setView(pixel_view);
+            profiler_overlay.draw(window, profiler);
+            window.setView(map_view);
+        }
 
-        // Put markers at predefined positions
-        for (const auto &city_coord : cities)
         {
-            city.setPosition(sf::Vector2f(400, 400) + 400.f * city_coord.to_azimuthal_equidistant());
-            window.draw(city);
+            FrameProfiler::Scope timer(profiler, FrameProfiler::Display);
+            window.display();
         }
 
-        window.display();
+        profiler.end_frame();
+
+        if (counting_allocations)
+        {
+            const auto allocations = allocation_count() - frame_allocations;
+            if (allocations > 0)
+            {
+                std::cerr << "Frame " << frame << ": " << allocations << " heap allocations" << std::endl;
+            }
+        }
+        ++frame;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--profile-csv" && i + 1 < argc)
+        {
+            options.profile_csv = argv[++i];
+        }
+        else if (arg == "--font" && i + 1 < argc)
+        {
+            options.font = argv[++i];
+        }
+        else if (arg == "--map-tiles" && i + 1 < argc)
+        {
+            options.map_tiles = argv[++i];
+        }
+        else if (arg == "--places" && i + 1 < argc)
+        {
+            options.places_file = argv[++i];
+        }
+        else if (arg == "--illumination-resolution" && i + 1 < argc)
+        {
+            options.illumination_resolution = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+        }
+        else if (arg == "--target-frame-ms" && i + 1 < argc)
+        {
+            options.target_frame_ms = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--projection" && i + 1 < argc)
+        {
+            options.projection = argv[++i];
+        }
+        else if (arg == "--realtime")
+        {
+            options.realtime = true;
+        }
+        else if (arg == "--event-driven")
+        {
+            options.event_driven = true;
+        }
+        else if (arg == "--max-fps" && i + 1 < argc)
+        {
+            options.max_fps = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+        }
+        else if (arg == "--vsync")
+        {
+            options.vsync = true;
+        }
+        else if (arg == "--time" && i + 1 < argc && parse_utc(argv[i + 1], options.time))
+        {
+            options.has_time = true;
+            ++i;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--threads N] [--profile-csv FILE] [--font FILE] [--map-tiles DIR] [--places FILE]\n"
+                      << "    [--illumination-resolution TILES] [--target-frame-ms MS] [--realtime | --time YYYY-MM-DDTHH:MM[:SS]Z]\n"
+                      << "    [--projection " << projection_names() << "] [--event-driven [--max-fps N]] [--vsync]" << std::endl;
+            return 1;
+        }
+    }
+
+    auto result = 0;
+    if (!with_projection(options.projection, [&](auto projection) { result = run<decltype(projection)>(options); }))
+    {
+        std::cerr << "Unknown projection " << options.projection << ", use one of " << projection_names() << std::endl;
+        return 1;
+    }
+    return result;
+}
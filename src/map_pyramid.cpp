@@ -0,0 +1,110 @@
+#include "map_pyramid.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+unsigned MapPyramidInfo::levels_for(unsigned width, unsigned height, unsigned tile_size)
+{
+    unsigned levels = 1;
+    for (auto size = std::max(width, height); size > tile_size; size = (size + 1) / 2)
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+bool MapPyramidInfo::save(const std::string &directory) const
+{
+    std::ofstream file(directory + "/pyramid.txt");
+    file << width << ' ' << height << ' ' << tile_size << ' ' << levels << ' ' << format << '\n';
+    return static_cast<bool>(file);
+}
+
+bool MapPyramidInfo::load(const std::string &directory)
+{
+    std::ifstream file(directory + "/pyramid.txt");
+    return file >> width >> height >> tile_size >> levels >> format && width && height && tile_size && levels;
+}
+
+sf::Vector2u MapPyramidInfo::level_size(unsigned level) const
+{
+    auto size = sf::Vector2u(width, height);
+    for (auto l = level + 1; l < levels; ++l)
+    {
+        size = sf::Vector2u((size.x + 1) / 2, (size.y + 1) / 2);
+    }
+    return size;
+}
+
+std::string MapPyramidInfo::tile_path(const std::string &directory, unsigned level, unsigned x, unsigned y) const
+{
+    return directory + "/tile_" + std::to_string(level) + "_" + std::to_string(x) + "_" + std::to_string(y) + "." + format;
+}
+
+bool MapPyramid::open(const std::string &directory)
+{
+    this->directory = directory;
+    tiles.clear();
+    return info.load(directory);
+}
+
+void MapPyramid::draw(sf::RenderTarget &target, sf::Vector2f origin, float size, float pixels_per_unit, const sf::FloatRect &visible)
+{
+    // Coarsest level with enough texels, each level down halves the resolution
+    auto wanted = info.levels - 1;
+    while (wanted > 0 && static_cast<float>(info.level_size(wanted - 1).x) >= pixels_per_unit * size)
+    {
+        --wanted;
+    }
+    if (wanted != level)
+    {
+        tiles.clear();
+        level = wanted;
+    }
+
+    // Map units per texel of the level, exact powers of two of the source's
+    const auto unit = size * static_cast<float>(1u << (info.levels - 1 - level)) / static_cast<float>(info.width);
+    const auto tile_units = unit * static_cast<float>(info.tile_size);
+    const auto level_size = info.level_size(level);
+    const auto columns = (level_size.x + info.tile_size - 1) / info.tile_size;
+    const auto rows = (level_size.y + info.tile_size - 1) / info.tile_size;
+
+    for (unsigned x = 0; x < columns; ++x)
+    {
+        for (unsigned y = 0; y < rows; ++y)
+        {
+            const auto position = origin + sf::Vector2f(static_cast<float>(x) * tile_units, static_cast<float>(y) * tile_units);
+            if (!visible.intersects(sf::FloatRect(position, sf::Vector2f(tile_units, tile_units))))
+            {
+                continue;
+            }
+
+            const auto key = std::make_pair(x, y);
+            auto tile = tiles.find(key);
+            if (tile == tiles.end())
+            {
+                tile = tiles.emplace(key, sf::Texture()).first;
+                const auto path = info.tile_path(directory, level, x, y);
+                if (tile->second.loadFromFile(path))
+                {
+                    tile->second.setSmooth(true);
+                    tile->second.generateMipmap();
+                }
+                else
+                {
+                    std::cerr << "Can't load " << path << std::endl;
+                }
+            }
+            if (tile->second.getSize().x == 0)
+            {
+                continue;
+            }
+
+            sf::Sprite sprite(tile->second);
+            sprite.setPosition(position);
+            sprite.setScale(sf::Vector2f(unit, unit));
+            target.draw(sprite);
+        }
+    }
+}
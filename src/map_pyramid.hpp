@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <SFML/Graphics.hpp>
+
+// Layout of a map pyramid on disk, written by FlatEarthMapTiles
+//
+// Level 0 is the whole map in a single tile, every further level doubles the
+// resolution up to the source image at `levels - 1`. Tiles are stored as
+// `tile_<level>_<x>_<y>.<format>` next to a `pyramid.txt` with these fields.
+struct MapPyramidInfo
+{
+    // Source image size in pixels
+    unsigned width = 0;
+    unsigned height = 0;
+
+    unsigned tile_size = 0;
+    unsigned levels = 0;
+    std::string format;
+
+    // Levels needed for `width`x`height` to fit a single tile at level 0
+    static unsigned levels_for(unsigned width, unsigned height, unsigned tile_size);
+
+    bool save(const std::string &directory) const;
+    bool load(const std::string &directory);
+
+    // Size of `level` in pixels, the source size halved and rounded up per level below the top one
+    sf::Vector2u level_size(unsigned level) const;
+
+    std::string tile_path(const std::string &directory, unsigned level, unsigned x, unsigned y) const;
+};
+
+// World map drawn from a MapPyramidInfo pyramid
+//
+// Only the tiles of the coarsest level that still has enough resolution for
+// the target are loaded, when they're first visible, and mipmapped for
+// smooth downscaling. Tiles of other levels are dropped, so startup time and
+// texture memory depend on the window size rather than the map resolution.
+class MapPyramid
+{
+public:
+    bool open(const std::string &directory);
+
+    // Draw the map `size` wide with its top left corner at `origin` of the
+    // target's view, the part of it within `visible` at least
+    // `pixels_per_unit` texels per unit where the pyramid allows
+    void draw(sf::RenderTarget &target, sf::Vector2f origin, float size, float pixels_per_unit, const sf::FloatRect &visible);
+
+private:
+    std::string directory;
+    MapPyramidInfo info;
+
+    // Tiles of `level` loaded so far, failed ones are kept empty so that they
+    // are only tried once
+    unsigned level = 0;
+    std::map<std::pair<unsigned, unsigned>, sf::Texture> tiles;
+};
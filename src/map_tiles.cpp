@@ -0,0 +1,168 @@
+// Preprocessor of world maps into tile pyramids for the viewer
+//
+// Decodes the source map once and writes it as tiles at every power of two
+// downscale, see MapPyramidInfo. The viewer then only decodes the tiles of
+// the level it draws, instead of the whole map on startup.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "map_pyramid.hpp"
+
+namespace
+{
+    struct Options
+    {
+        std::string map = "../../map.jpg";
+        std::string out = ".";
+        std::string format = "jpg";
+        unsigned tile_size = 512;
+    };
+
+    // Halve `image` with a 2x2 box filter, the last row and column alone if odd
+    sf::Image halve(const sf::Image &image)
+    {
+        const auto size = image.getSize();
+        const auto half = sf::Vector2u((size.x + 1) / 2, (size.y + 1) / 2);
+        const auto *pixels = image.getPixelsPtr();
+        std::vector<std::uint8_t> out(static_cast<std::size_t>(half.x) * half.y * 4);
+
+        for (unsigned y = 0; y < half.y; ++y)
+        {
+            const auto y1 = std::min(2 * y + 2, size.y);
+            for (unsigned x = 0; x < half.x; ++x)
+            {
+                const auto x1 = std::min(2 * x + 2, size.x);
+
+                unsigned sum[4] = {};
+                for (auto sy = 2 * y; sy < y1; ++sy)
+                {
+                    for (auto sx = 2 * x; sx < x1; ++sx)
+                    {
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            sum[c] += pixels[(static_cast<std::size_t>(sy) * size.x + sx) * 4 + c];
+                        }
+                    }
+                }
+
+                const auto count = (y1 - 2 * y) * (x1 - 2 * x);
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[(static_cast<std::size_t>(y) * half.x + x) * 4 + c] = static_cast<std::uint8_t>(sum[c] / count);
+                }
+            }
+        }
+
+        sf::Image result;
+        result.create(half.x, half.y, out.data());
+        return result;
+    }
+
+    // Write `image` as the tiles of `level`
+    bool save_tiles(const sf::Image &image, const MapPyramidInfo &info, const std::string &directory, unsigned level)
+    {
+        const auto size = image.getSize();
+        for (unsigned x = 0; x * info.tile_size < size.x; ++x)
+        {
+            for (unsigned y = 0; y * info.tile_size < size.y; ++y)
+            {
+                const auto left = x * info.tile_size;
+                const auto top = y * info.tile_size;
+                const auto width = std::min(info.tile_size, size.x - left);
+                const auto height = std::min(info.tile_size, size.y - top);
+
+                sf::Image tile;
+                tile.create(width, height);
+                tile.copy(image, 0, 0, sf::IntRect(static_cast<int>(left), static_cast<int>(top), static_cast<int>(width), static_cast<int>(height)));
+
+                const auto path = info.tile_path(directory, level, x, y);
+                if (!tile.saveToFile(path))
+                {
+                    std::cerr << "Can't write " << path << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    auto valid = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto has_value = i + 1 < argc;
+        if (arg == "--map" && has_value)
+        {
+            options.map = argv[++i];
+        }
+        else if (arg == "--out" && has_value)
+        {
+            options.out = argv[++i];
+        }
+        else if (arg == "--format" && has_value)
+        {
+            options.format = argv[++i];
+        }
+        else if (arg == "--tile-size" && has_value)
+        {
+            options.tile_size = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    if (!valid || options.tile_size == 0 || (options.format != "png" && options.format != "jpg"))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--map FILE] [--out EXISTING_DIR] [--format png|jpg] [--tile-size PX]" << std::endl;
+        return 1;
+    }
+
+    sf::Image image;
+    if (!image.loadFromFile(options.map))
+    {
+        std::cerr << "Can't load " << options.map << std::endl;
+        return 1;
+    }
+
+    MapPyramidInfo info;
+    info.width = image.getSize().x;
+    info.height = image.getSize().y;
+    info.tile_size = options.tile_size;
+    info.levels = MapPyramidInfo::levels_for(info.width, info.height, info.tile_size);
+    info.format = options.format;
+
+    // Finest level first, every coarser one is halved from the previous
+    for (auto level = info.levels; level-- > 0;)
+    {
+        if (!save_tiles(image, info, options.out, level))
+        {
+            return 1;
+        }
+        if (level > 0)
+        {
+            image = halve(image);
+        }
+    }
+
+    if (!info.save(options.out))
+    {
+        std::cerr << "Can't write " << options.out << "/pyramid.txt" << std::endl;
+        return 1;
+    }
+
+    std::cout << info.levels << " levels of " << info.tile_size << " px tiles in " << options.out << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "place_layer.hpp"
+
+#include <cmath>
+#include <utility>
+
+#include "projection.hpp"
+#include "sfml_vec.hpp"
+
+namespace
+{
+    const auto marker_radius_px = 4.f;
+    const auto hovered_radius_px = 6.f;
+    const sf::Color marker_color(220, 30, 30);
+    const sf::Color hovered_color(255, 255, 255);
+
+    // Corners of the hexagon approximating a marker circle
+    const auto corners = 6;
+
+    void append_marker(sf::VertexArray &markers, sf::Vector2f center, float radius, sf::Color color)
+    {
+        const auto step = 2.f * pi / corners;
+        for (int i = 0; i < corners; ++i)
+        {
+            const auto a = static_cast<float>(i) * step;
+            const auto b = a + step;
+            markers.append(sf::Vertex(center, color));
+            markers.append(sf::Vertex(center + radius * sf::Vector2f(std::cos(a), std::sin(a)), color));
+            markers.append(sf::Vertex(center + radius * sf::Vector2f(std::cos(b), std::sin(b)), color));
+        }
+    }
+}
+
+template <typename Projection>
+void PlaceLayer::set(std::vector<Place> places, float map_size)
+{
+    this->places.clear();
+
+    const auto radius = map_size / 2.f;
+    positions.clear();
+    std::vector<LatLon> coords;
+    for (auto &place : places)
+    {
+        Vec2 position;
+        if (!Projection::forward(place.coords, position))
+        {
+            continue;
+        }
+        positions.push_back(Vec2{radius, radius} + radius * position);
+        coords.push_back(place.coords);
+        this->places.push_back(std::move(place));
+    }
+    sphere.build(coords.data(), coords.size());
+
+    // Cells around the size of a marker on the default window
+    index.build(positions, Vec2{0.f, 0.f}, Vec2{map_size, map_size}, 8.f);
+    hovered = none;
+    dirty = true;
+}
+
+template void PlaceLayer::set<AzimuthalEquidistant>(std::vector<Place>, float);
+template void PlaceLayer::set<Equirectangular>(std::vector<Place>, float);
+template void PlaceLayer::set<Orthographic>(std::vector<Place>, float);
+template void PlaceLayer::set<Mercator>(std::vector<Place>, float);
+
+void PlaceLayer::draw(sf::RenderTarget &target, float pixel)
+{
+    const auto &view = target.getView();
+    const auto visible = sf::FloatRect(view.getCenter() - view.getSize() / 2.f, view.getSize());
+    if (dirty || visible != markers_view)
+    {
+        // Culled to the view, with a margin for markers straddling its edge
+        const auto margin = sf::Vector2f(marker_radius_px, marker_radius_px) * pixel;
+        markers.clear();
+        index.visit(from_sfml(visible.getPosition() - margin), from_sfml(visible.getPosition() + visible.getSize() + margin), [&](std::size_t i) {
+            append_marker(markers, to_sfml(positions[i]), marker_radius_px * pixel, marker_color);
+        });
+
+        markers_view = visible;
+        dirty = false;
+    }
+
+    target.draw(markers);
+
+    if (hovered != none)
+    {
+        highlight.clear();
+        append_marker(highlight, to_sfml(positions[hovered]), hovered_radius_px * pixel, hovered_color);
+        append_marker(highlight, to_sfml(positions[hovered]), marker_radius_px * pixel, marker_color);
+        target.draw(highlight);
+    }
+}
+
+std::size_t PlaceLayer::find(sf::Vector2f position, float radius) const
+{
+    return index.nearest(from_sfml(position), radius);
+}
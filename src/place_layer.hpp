@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "places.hpp"
+#include "point_grid.hpp"
+#include "sphere_index.hpp"
+
+// Markers for a large set of places, drawn with a single draw call
+//
+// Places are projected once when set and indexed with a PointGrid. The
+// vertex array only holds the places within the view and is rebuilt when the
+// view changes, since markers keep their size in pixels. Hover lookups use
+// the same index, while queries by great-circle distance go to a SphereIndex.
+class PlaceLayer
+{
+public:
+    static constexpr std::size_t none = PointGrid::npos;
+
+    // Places on a `map_size`x`map_size` map at the origin, drawn in
+    // `Projection`. Those it doesn't show are left out.
+    template <typename Projection>
+    void set(std::vector<Place> places, float map_size);
+
+    // Rebuild the markers on the next draw
+    void invalidate() { dirty = true; }
+
+    // Draw with the target's current view, `pixel` map units per pixel
+    void draw(sf::RenderTarget &target, float pixel);
+
+    // Place within `radius` map units of `position`, `none` if there's none
+    std::size_t find(sf::Vector2f position, float radius) const;
+
+    const Place &place(std::size_t index) const { return places[index]; }
+
+    // Places by great-circle distance, with the same indices as place()
+    const SphereIndex &spherical_index() const { return sphere; }
+
+    // Highlight a place, `none` for no highlight
+    void set_hovered(std::size_t index) { hovered = index; }
+
+private:
+    std::vector<Place> places;
+    std::vector<Vec2> positions;
+    PointGrid index;
+    SphereIndex sphere;
+
+    sf::VertexArray markers{sf::Triangles};
+    // Separate from the markers, so that hovering doesn't rebuild them
+    sf::VertexArray highlight{sf::Triangles};
+    bool dirty = true;
+    sf::FloatRect markers_view;
+
+    std::size_t hovered = none;
+};
@@ -0,0 +1,132 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    double to_ms(FrameProfiler::Clock::duration time)
+    {
+        return std::chrono::duration<double, std::milli>(time).count();
+    }
+}
+
+const char *FrameProfiler::stage_name(Stage stage)
+{
+    switch (stage)
+    {
+    case Events:
+        return "events";
+    case Illumination:
+        return "illumination";
+    case MapDraw:
+        return "map";
+    case Markers:
+        return "markers";
+    case Display:
+        return "display";
+    default:
+        return "?";
+    }
+}
+
+FrameProfiler::FrameProfiler(std::size_t history) : frames(std::max<std::size_t>(history, 1)), sorted(frames.size())
+{
+}
+
+bool FrameProfiler::open_csv(const std::string &path)
+{
+    csv.open(path);
+    if (!csv)
+    {
+        return false;
+    }
+
+    csv << "frame,total_ms";
+    for (int stage = 0; stage < StageCount; ++stage)
+    {
+        csv << ',' << stage_name(static_cast<Stage>(stage)) << "_ms";
+    }
+    csv << '\n';
+    return true;
+}
+
+void FrameProfiler::begin_frame()
+{
+    const auto now = Clock::now();
+    current = Frame{};
+    current.interval_ms = started ? to_ms(now - frame_start) : 0.;
+    frame_start = now;
+    started = true;
+}
+
+void FrameProfiler::end_frame()
+{
+    current.total_ms = to_ms(Clock::now() - frame_start);
+
+    frames[next] = current;
+    next = (next + 1) % frames.size();
+    recorded = std::min(recorded + 1, frames.size());
+
+    if (csv)
+    {
+        csv << frame_number << ',' << current.total_ms;
+        for (const auto ms : current.stage_ms)
+        {
+            csv << ',' << ms;
+        }
+        csv << '\n';
+    }
+    ++frame_number;
+}
+
+void FrameProfiler::add(Stage stage, Clock::duration time)
+{
+    current.stage_ms[stage] += to_ms(time);
+}
+
+double FrameProfiler::fps() const
+{
+    auto total = 0.;
+    std::size_t intervals = 0;
+    for (std::size_t i = 0; i < recorded; ++i)
+    {
+        if (frames[i].interval_ms > 0.)
+        {
+            total += frames[i].interval_ms;
+            ++intervals;
+        }
+    }
+    return total > 0. ? 1000. * intervals / total : 0.;
+}
+
+double FrameProfiler::frame_percentile(double percentile) const
+{
+    if (recorded == 0)
+    {
+        return 0.;
+    }
+
+    for (std::size_t i = 0; i < recorded; ++i)
+    {
+        sorted[i] = frames[i].total_ms;
+    }
+
+    const auto rank = static_cast<std::size_t>(percentile / 100. * (recorded - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + recorded);
+    return sorted[rank];
+}
+
+double FrameProfiler::stage_mean(Stage stage) const
+{
+    if (recorded == 0)
+    {
+        return 0.;
+    }
+
+    auto total = 0.;
+    for (std::size_t i = 0; i < recorded; ++i)
+    {
+        total += frames[i].stage_ms[stage];
+    }
+    return total / recorded;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Per-stage timings of the frame loop
+//
+// Stage times are accumulated with Scope timers between begin_frame() and
+// end_frame(). The last `history` frames are kept for the statistics, and
+// every frame can additionally be logged to a CSV file.
+class FrameProfiler
+{
+public:
+    enum Stage
+    {
+        Events,
+        Illumination,
+        MapDraw,
+        Markers,
+        Display,
+        StageCount,
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Times everything until the end of the enclosing scope into `stage`
+    class Scope
+    {
+    public:
+        Scope(FrameProfiler &profiler, Stage stage) : profiler(profiler), stage(stage), start(Clock::now()) {}
+        ~Scope() { profiler.add(stage, Clock::now() - start); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        FrameProfiler &profiler;
+        Stage stage;
+        Clock::time_point start;
+    };
+
+    static const char *stage_name(Stage stage);
+
+    explicit FrameProfiler(std::size_t history = 240);
+
+    // Log every following frame to `path`, false if it can't be opened
+    bool open_csv(const std::string &path);
+
+    void begin_frame();
+    void end_frame();
+
+    void add(Stage stage, Clock::duration time);
+
+    // Statistics over the recorded history, in milliseconds. fps() counts
+    // wall-clock time from one begin_frame() to the next, idle time in
+    // between frames included, the rest only the time inside them.
+    double fps() const;
+    double frame_percentile(double percentile) const;
+    double stage_mean(Stage stage) const;
+
+private:
+    struct Frame
+    {
+        double total_ms = 0.;
+        // Since the previous begin_frame(), 0 for the first frame
+        double interval_ms = 0.;
+        std::array<double, StageCount> stage_ms{};
+    };
+
+    // Ring buffer of the last frames, `recorded` of them valid
+    std::vector<Frame> frames;
+    std::size_t next = 0;
+    std::size_t recorded = 0;
+
+    Frame current;
+    Clock::time_point frame_start;
+    std::size_t frame_number = 0;
+    bool started = false;
+
+    mutable std::vector<double> sorted;
+    std::ofstream csv;
+};
@@ -0,0 +1,98 @@
+#include "profiler_overlay.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const sf::Color stage_colors[] = {
+        sf::Color(90, 160, 230),
+        sf::Color(230, 120, 40),
+        sf::Color(120, 200, 90),
+        sf::Color(220, 30, 30),
+        sf::Color(170, 110, 210),
+    };
+
+    const auto bar_width_px = 300.f;
+    const auto bar_height_px = 12.f;
+    const auto budget_ms = 1000.f / 60.f;
+
+    void append_rect(sf::VertexArray &vertices, float x, float y, float width, float height, sf::Color color)
+    {
+        const sf::Vector2f corners[] = {{x, y}, {x + width, y}, {x + width, y + height}, {x, y + height}};
+        for (const auto i : {0, 1, 2, 0, 2, 3})
+        {
+            vertices.append(sf::Vertex(corners[i], color));
+        }
+    }
+}
+
+bool ProfilerOverlay::load_font(const std::string &path)
+{
+    has_font = font.loadFromFile(path);
+    if (has_font)
+    {
+        text = sf::Text("", font, 14);
+        text.setFillColor(sf::Color::White);
+        text.setOutlineColor(sf::Color::Black);
+        text.setOutlineThickness(1.f);
+    }
+    return has_font;
+}
+
+void ProfilerOverlay::draw(sf::RenderWindow &window, const FrameProfiler &profiler)
+{
+    const auto margin = 10.f;
+
+    // Backdrop, frame budget and one segment per stage
+    bars.clear();
+    append_rect(bars, 0.f, 0.f, bar_width_px + margin * 2, bar_height_px + margin * 2, sf::Color(0, 0, 0, 160));
+
+    auto x = margin;
+    for (int stage = 0; stage < FrameProfiler::StageCount; ++stage)
+    {
+        const auto ms = static_cast<float>(profiler.stage_mean(static_cast<FrameProfiler::Stage>(stage)));
+        const auto width = std::min(ms / budget_ms * bar_width_px, bar_width_px + margin - x);
+        append_rect(bars, x, margin, std::max(width, 0.f), bar_height_px, stage_colors[stage]);
+        x += width;
+    }
+    window.draw(bars);
+
+    if (!refreshed || refresh_clock.getElapsedTime() > sf::seconds(0.5f))
+    {
+        summarize(profiler);
+        if (has_font)
+        {
+            text.setString(summary);
+            text.setPosition(margin, bar_height_px + margin * 2);
+        }
+        else
+        {
+            window.setTitle(summary);
+        }
+        refresh_clock.restart();
+        refreshed = true;
+    }
+
+    if (has_font)
+    {
+        window.draw(text);
+    }
+}
+
+void ProfilerOverlay::summarize(const FrameProfiler &profiler)
+{
+    // Multi-line with a font, a single title line without
+    const auto separator = has_font ? "\n" : "  ";
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "%.1f FPS  p50 %.2f ms  p99 %.2f ms", profiler.fps(), profiler.frame_percentile(50.), profiler.frame_percentile(99.));
+    summary = line;
+
+    for (int stage = 0; stage < FrameProfiler::StageCount; ++stage)
+    {
+        const auto s = static_cast<FrameProfiler::Stage>(stage);
+        std::snprintf(line, sizeof(line), "%s%s %.2f ms", separator, FrameProfiler::stage_name(s), profiler.stage_mean(s));
+        summary += line;
+    }
+}
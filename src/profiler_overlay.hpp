@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+#include <SFML/Graphics.hpp>
+
+#include "profiler.hpp"
+
+// On-screen view of a FrameProfiler
+//
+// Stage times are drawn as a stacked bar, scaled so that the full width is a
+// 60 FPS frame. The numbers are drawn as text if a font was loaded, and go
+// to the window title otherwise, either way refreshed a few times per
+// second. Shapes and text are kept between frames, so drawing only
+// allocates when the numbers are refreshed.
+class ProfilerOverlay
+{
+public:
+    bool load_font(const std::string &path);
+
+    // Draw in pixel coordinates, the target's view has to match its size
+    void draw(sf::RenderWindow &window, const FrameProfiler &profiler);
+
+private:
+    // Format the numbers into `text`
+    void summarize(const FrameProfiler &profiler);
+
+    sf::Font font;
+    bool has_font = false;
+
+    // Backdrop and stage bar
+    sf::VertexArray bars{sf::Triangles};
+
+    std::string summary;
+    sf::Text text;
+    sf::Clock refresh_clock;
+    bool refreshed = false;
+};
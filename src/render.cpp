@@ -0,0 +1,310 @@
+// Offline renderer of day/night frames for a time series
+//
+// Renders the map with the illumination overlay for every `interval` between
+// `start` and `end` and writes one image per timestamp. Frames are rendered
+// on the CPU in parallel and handed to separate encoder threads through a
+// small pool of reusable buffers, so that image compression overlaps with
+// rendering instead of serializing behind it.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "illumination.hpp"
+#include "quadtree.hpp"
+#include "solar.hpp"
+
+namespace
+{
+    // Shadow opacity at night, same as the viewer's, scaled by the ShadowRamp
+    // level through twilight
+    const unsigned night_alpha = 220;
+
+    // Blocking FIFO shared between pipeline stages
+    template <typename T>
+    class Channel
+    {
+    public:
+        void push(T value)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                items.push_back(std::move(value));
+            }
+            ready.notify_one();
+        }
+
+        // False once the channel is closed and drained
+        bool pop(T &value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&] { return !items.empty() || closed; });
+            if (items.empty())
+            {
+                return false;
+            }
+
+            value = std::move(items.front());
+            items.pop_front();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            ready.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<T> items;
+        bool closed = false;
+    };
+
+    struct Frame
+    {
+        std::int64_t time = 0;
+        std::vector<std::uint8_t> pixels;
+    };
+
+    struct Options
+    {
+        std::int64_t start = 0;
+        std::int64_t end = 0;
+        std::int64_t interval = 300;
+        std::string map = "../../map.jpg";
+        std::string out = ".";
+        std::string format = "png";
+        unsigned size = 800;
+        unsigned render_threads = 0;
+        unsigned encode_threads = 0;
+    };
+
+    // Seconds, optionally suffixed with s, m, h or d
+    bool parse_interval(const std::string &text, std::int64_t &seconds)
+    {
+        char *end = nullptr;
+        const auto value = std::strtoll(text.c_str(), &end, 10);
+        const std::string unit = end;
+        const std::int64_t scale = unit.empty() || unit == "s" ? 1 : unit == "m" ? 60 : unit == "h" ? 3600 : unit == "d" ? 86400 : 0;
+        seconds = value * scale;
+        return end != text.c_str() && seconds > 0;
+    }
+
+    // Area-average `source` into a `size`x`size` RGBA buffer
+    std::vector<std::uint8_t> resample(const sf::Image &source, unsigned size)
+    {
+        const auto source_size = source.getSize();
+        const auto *pixels = source.getPixelsPtr();
+        std::vector<std::uint8_t> out(static_cast<std::size_t>(size) * size * 4);
+
+        for (unsigned y = 0; y < size; ++y)
+        {
+            const auto y0 = y * source_size.y / size;
+            const auto y1 = std::max(y0 + 1, (y + 1) * source_size.y / size);
+            for (unsigned x = 0; x < size; ++x)
+            {
+                const auto x0 = x * source_size.x / size;
+                const auto x1 = std::max(x0 + 1, (x + 1) * source_size.x / size);
+
+                unsigned sum[4] = {};
+                for (auto sy = y0; sy < y1; ++sy)
+                {
+                    for (auto sx = x0; sx < x1; ++sx)
+                    {
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            sum[c] += pixels[(static_cast<std::size_t>(sy) * source_size.x + sx) * 4 + c];
+                        }
+                    }
+                }
+
+                const auto count = (y1 - y0) * (x1 - x0);
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[(static_cast<std::size_t>(y) * size + x) * 4 + c] = static_cast<std::uint8_t>(sum[c] / count);
+                }
+            }
+        }
+
+        return out;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    auto have_start = false;
+    auto have_end = false;
+    auto valid = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto has_value = i + 1 < argc;
+        if (arg == "--start" && has_value)
+        {
+            have_start = parse_utc(argv[++i], options.start);
+        }
+        else if (arg == "--end" && has_value)
+        {
+            have_end = parse_utc(argv[++i], options.end);
+        }
+        else if (arg == "--interval" && has_value)
+        {
+            valid = parse_interval(argv[++i], options.interval);
+        }
+        else if (arg == "--map" && has_value)
+        {
+            options.map = argv[++i];
+        }
+        else if (arg == "--out" && has_value)
+        {
+            options.out = argv[++i];
+        }
+        else if (arg == "--format" && has_value)
+        {
+            options.format = argv[++i];
+        }
+        else if (arg == "--size" && has_value)
+        {
+            options.size = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--render-threads" && has_value)
+        {
+            options.render_threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--encode-threads" && has_value)
+        {
+            options.encode_threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    if (!valid || !have_start || !have_end || options.end < options.start || options.size == 0 || (options.format != "png" && options.format != "jpg"))
+    {
+        std::cerr << "Usage: " << argv[0] << " --start YYYY-MM-DDTHH:MM[:SS]Z --end YYYY-MM-DDTHH:MM[:SS]Z\n"
+                  << "    [--interval SECONDS[s|m|h|d]] [--map FILE] [--out EXISTING_DIR] [--format png|jpg] [--size PX]\n"
+                  << "    [--render-threads N] [--encode-threads N]" << std::endl;
+        return 1;
+    }
+
+    sf::Image map;
+    if (!map.loadFromFile(options.map))
+    {
+        std::cerr << "Can't load " << options.map << std::endl;
+        return 1;
+    }
+    const auto base = resample(map, options.size);
+
+    // Compression is the slower stage, give it the larger share of the cores
+    const auto cores = std::max(std::thread::hardware_concurrency(), 2u);
+    const auto render_threads = options.render_threads ? options.render_threads : std::max(cores / 3, 1u);
+    const auto encode_threads = options.encode_threads ? options.encode_threads : std::max(cores - render_threads, 1u);
+
+    // One pixel per tile, classified on a quadtree so that no per-tile grid
+    // has to be kept in memory for large outputs
+    const auto size = static_cast<float>(options.size);
+    const auto cutoffs = IlluminationCutoffs::standard();
+
+    const auto frame_count = static_cast<std::size_t>((options.end - options.start) / options.interval + 1);
+    std::atomic<std::size_t> next_frame{0};
+    std::atomic<std::size_t> failures{0};
+
+    // Buffers circulate from free to encode and back, which bounds memory use
+    // to a couple of frames per thread
+    Channel<Frame> free_frames;
+    Channel<Frame> encode_queue;
+    for (unsigned i = 0; i < 2 * (render_threads + encode_threads); ++i)
+    {
+        free_frames.push(Frame{0, std::vector<std::uint8_t>(base.size())});
+    }
+
+    std::vector<std::thread> renderers;
+    for (unsigned t = 0; t < render_threads; ++t)
+    {
+        renderers.emplace_back([&] {
+            std::vector<Illumination> illumination(static_cast<std::size_t>(options.size) * options.size);
+            std::vector<std::uint8_t> shade(illumination.size());
+            Frame frame;
+            for (auto i = next_frame++; i < frame_count; i = next_frame++)
+            {
+                if (!free_frames.pop(frame))
+                {
+                    return;
+                }
+
+                frame.time = options.start + static_cast<std::int64_t>(i) * options.interval;
+                classify_quadtree(subsolar_point(static_cast<double>(frame.time)), cutoffs, size, 1.f, illumination.data(), shade.data());
+
+                // Shadows are black, so blending scales the map color down
+                std::copy(base.begin(), base.end(), frame.pixels.begin());
+                for (std::size_t tile = 0; tile < shade.size(); ++tile)
+                {
+                    const auto alpha = shade[tile] * night_alpha / 255;
+                    if (alpha == 0)
+                    {
+                        continue;
+                    }
+
+                    const auto pixel = tile * 4;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        frame.pixels[pixel + c] = static_cast<std::uint8_t>(frame.pixels[pixel + c] * (255 - alpha) / 255);
+                    }
+                }
+
+                encode_queue.push(std::move(frame));
+            }
+        });
+    }
+
+    std::vector<std::thread> encoders;
+    for (unsigned t = 0; t < encode_threads; ++t)
+    {
+        encoders.emplace_back([&] {
+            sf::Image image;
+            Frame frame;
+            while (encode_queue.pop(frame))
+            {
+                image.create(options.size, options.size, frame.pixels.data());
+                const auto path = options.out + "/frame_" + format_utc(frame.time) + "." + options.format;
+                if (!image.saveToFile(path))
+                {
+                    ++failures;
+                }
+
+                free_frames.push(std::move(frame));
+            }
+        });
+    }
+
+    for (auto &thread : renderers)
+    {
+        thread.join();
+    }
+    encode_queue.close();
+    for (auto &thread : encoders)
+    {
+        thread.join();
+    }
+
+    std::cout << "Rendered " << frame_count - failures << " of " << frame_count << " frames to " << options.out << std::endl;
+    return failures == 0 ? 0 : 1;
+}
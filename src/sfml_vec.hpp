@@ -0,0 +1,17 @@
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+
+#include "vec.hpp"
+
+// Conversions between the core's vector type and SFML's
+
+inline sf::Vector2f to_sfml(Vec2 v)
+{
+    return sf::Vector2f(v.x, v.y);
+}
+
+inline Vec2 from_sfml(sf::Vector2f v)
+{
+    return Vec2{v.x, v.y};
+}
@@ -0,0 +1,249 @@
+#include "texture_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+#endif
+
+namespace
+{
+    // Cache file layout, followed by width * height RGBA pixels
+    struct CacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t source_hash;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    const char cache_magic[4] = {'F', 'E', 'T', 'C'};
+    const std::uint32_t cache_version = 1;
+
+    // 64-bit FNV-1a
+    std::uint64_t hash_bytes(const std::uint8_t *bytes, std::size_t size)
+    {
+        auto hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Write to a temporary file and rename it over the cache, so that an
+    // interrupted write never leaves a truncated cache behind
+    bool write_cache(const std::string &cache, const CacheHeader &header, const sf::Image &image)
+    {
+        const auto temporary = cache + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(image.getPixelsPtr()), static_cast<std::streamsize>(header.width) * header.height * 4);
+            if (!file)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+
+        std::remove(cache.c_str());
+        return std::rename(temporary.c_str(), cache.c_str()) == 0;
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    bytes = mapping ? static_cast<const std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!bytes)
+    {
+        close();
+        return false;
+    }
+    length = static_cast<std::size_t>(file_size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+    {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping)
+    {
+        CloseHandle(mapping);
+    }
+    if (file)
+    {
+        CloseHandle(file);
+    }
+    bytes = nullptr;
+    length = 0;
+    mapping = nullptr;
+    file = nullptr;
+}
+#else
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    file = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    const auto size = static_cast<std::size_t>(status.st_size);
+    auto *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapped == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    bytes = static_cast<const std::uint8_t *>(mapped);
+    length = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+    {
+        munmap(const_cast<std::uint8_t *>(bytes), length);
+    }
+    if (file >= 0)
+    {
+        ::close(file);
+    }
+    bytes = nullptr;
+    length = 0;
+    file = -1;
+}
+#endif
+
+std::string executable_directory()
+{
+    std::string path;
+#ifdef _WIN32
+    char buffer[MAX_PATH];
+    const auto length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+    if (length > 0 && length < MAX_PATH)
+    {
+        path.assign(buffer, length);
+    }
+    const auto separator = path.find_last_of("\\/");
+#elif defined(__APPLE__)
+    char buffer[4096];
+    auto size = static_cast<std::uint32_t>(sizeof(buffer));
+    if (_NSGetExecutablePath(buffer, &size) == 0)
+    {
+        path = buffer;
+    }
+    const auto separator = path.rfind('/');
+#else
+    char buffer[4096];
+    const auto length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+    if (length > 0 && static_cast<std::size_t>(length) < sizeof(buffer))
+    {
+        path.assign(buffer, static_cast<std::size_t>(length));
+    }
+    const auto separator = path.rfind('/');
+#endif
+    return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+bool load_texture_cached(sf::Texture &texture, const std::string &source, const std::string &cache)
+{
+    return load_texture_cached(texture, source, cache, nullptr);
+}
+
+bool load_texture_cached(sf::Texture &texture, const std::string &source, const std::string &cache,
+                         const std::function<void(const sf::Image &source, sf::Image &out)> &derive)
+{
+    // The source is hashed from a mapping too, which costs far less than decoding it
+    MappedFile source_file;
+    if (!source_file.open(source))
+    {
+        return false;
+    }
+    const auto source_hash = hash_bytes(source_file.data(), source_file.size());
+
+    MappedFile cache_file;
+    CacheHeader header;
+    if (cache_file.open(cache) && cache_file.size() >= sizeof(header))
+    {
+        std::memcpy(&header, cache_file.data(), sizeof(header));
+        const auto pixel_bytes = static_cast<std::size_t>(header.width) * header.height * 4;
+        const auto valid = std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 && header.version == cache_version &&
+                           header.source_hash == source_hash && cache_file.size() == sizeof(header) + pixel_bytes;
+        if (valid && texture.create(header.width, header.height))
+        {
+            texture.update(cache_file.data() + sizeof(header));
+            return true;
+        }
+    }
+    cache_file.close();
+
+    sf::Image image;
+    if (!image.loadFromMemory(source_file.data(), source_file.size()))
+    {
+        return false;
+    }
+    if (derive)
+    {
+        sf::Image derived;
+        derive(image, derived);
+        image = derived;
+    }
+    if (!texture.loadFromImage(image))
+    {
+        return false;
+    }
+
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.source_hash = source_hash;
+    header.width = image.getSize().x;
+    header.height = image.getSize().y;
+    write_cache(cache, header, image);
+    return true;
+}
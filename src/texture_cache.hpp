@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <SFML/Graphics.hpp>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    bool open(const std::string &path);
+    void close();
+
+    const std::uint8_t *data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    const std::uint8_t *bytes = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#else
+    int file = -1;
+#endif
+};
+
+// Directory of the running executable, with a trailing separator, or empty
+// if it can't be determined
+std::string executable_directory();
+
+// Load `source` into `texture` through a cache of the decoded pixels
+//
+// The cache holds the raw RGBA pixels along with a hash of the source file.
+// If it matches, it's memory-mapped and uploaded as is, skipping the image
+// decode. Otherwise the source is decoded and the cache rewritten, so a
+// changed source is never served stale. Failing to write the cache isn't an
+// error, only failing to load the source is.
+bool load_texture_cached(sf::Texture &texture, const std::string &source, const std::string &cache);
+
+// Same, with the decoded source turned into the texture's image by `derive`
+// first, so that its result is what's cached. Each `cache` should only ever
+// be used with one `derive`, as the cache is keyed on the source alone.
+bool load_texture_cached(sf::Texture &texture, const std::string &source, const std::string &cache,
+                         const std::function<void(const sf::Image &source, sf::Image &out)> &derive);
@@ -0,0 +1,535 @@
+// Headless server of illumination overlays as z/x/y map tiles over HTTP
+//
+// Answers `GET /<z>/<x>/<y>.png[?time=YYYY-MM-DDTHH:MM[:SS]Z]` with the
+// shadow for that tile of the map, drawn in the chosen projection, as a
+// transparent PNG to lay over a map. Zoom level z splits the map into 2^z by
+// 2^z tiles. Without a time the tile is for now.
+//
+// The sun position is rounded to --sun-step degrees, and rendered tiles are
+// kept in an LRU cache keyed by it and the tile, so that all clients asking
+// for the same tile within a step share one rendering and one encode.
+// Connections are handed to a fixed set of handler threads, each with its own
+// grid and buffers.
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Network.hpp>
+
+#include "illumination.hpp"
+#include "projection.hpp"
+#include "solar.hpp"
+#include "thread_pool.hpp"
+#include "tile_grid.hpp"
+
+namespace
+{
+    // Shadow opacity at night, same as the viewer's, scaled by the ShadowRamp
+    // level through twilight
+    const unsigned night_alpha = 220;
+
+    // Requests larger than this are refused, they can't be a tile request
+    const std::size_t max_request_bytes = 8192;
+
+    // Time a client gets to send its request before the connection is dropped
+    const auto request_timeout = sf::seconds(5.f);
+
+    // Same for reading the response, and how often a full send buffer is retried
+    const auto response_timeout = sf::seconds(5.f);
+    const auto send_retry = sf::milliseconds(5);
+
+    // Blocking FIFO between the listener and the handler threads
+    template <typename T>
+    class Channel
+    {
+    public:
+        void push(T value)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                items.push_back(std::move(value));
+            }
+            ready.notify_one();
+        }
+
+        void pop(T &value)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&] { return !items.empty(); });
+            value = std::move(items.front());
+            items.pop_front();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<T> items;
+    };
+
+    // Tile along with the sun position it's rendered for, in --sun-step units
+    struct TileKey
+    {
+        int sun_lat;
+        int sun_lon;
+        unsigned z;
+        unsigned x;
+        unsigned y;
+
+        bool operator==(const TileKey &other) const
+        {
+            return sun_lat == other.sun_lat && sun_lon == other.sun_lon && z == other.z && x == other.x && y == other.y;
+        }
+    };
+
+    struct TileKeyHash
+    {
+        std::size_t operator()(const TileKey &key) const
+        {
+            auto hash = std::hash<std::uint64_t>()(static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.sun_lat)) << 32 | static_cast<std::uint32_t>(key.sun_lon));
+            for (const auto value : {key.z, key.x, key.y})
+            {
+                hash = hash * 31 + value;
+            }
+            return hash;
+        }
+    };
+
+    // Encoded tile, empty if rendering it failed
+    struct CachedTile
+    {
+        std::vector<sf::Uint8> png;
+        bool ready = false;
+    };
+
+    // The most recently used `capacity` tiles
+    //
+    // A tile is entered as soon as one thread starts rendering it, so that
+    // others asking for it meanwhile wait for that rendering instead of
+    // repeating it. Entries are shared, so eviction never pulls a tile from
+    // under a thread still sending it.
+    class TileCache
+    {
+    public:
+        explicit TileCache(std::size_t capacity)
+            : capacity(std::max<std::size_t>(capacity, 1))
+        {
+        }
+
+        // The tile at `key`, from the cache or after `render(png)` encoded it
+        template <typename Render>
+        std::shared_ptr<const CachedTile> get(const TileKey &key, Render &&render)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            const auto found = index.find(key);
+            if (found != index.end())
+            {
+                order.splice(order.begin(), order, found->second.position);
+                const auto tile = found->second.tile;
+                rendered.wait(lock, [&] { return tile->ready; });
+                return tile;
+            }
+
+            const auto tile = std::make_shared<CachedTile>();
+            order.push_front(key);
+            index.emplace(key, Entry{order.begin(), tile});
+            while (index.size() > capacity)
+            {
+                index.erase(order.back());
+                order.pop_back();
+            }
+            lock.unlock();
+
+            render(tile->png);
+
+            lock.lock();
+            tile->ready = true;
+            // Failures are retried by the next request
+            const auto entry = index.find(key);
+            if (tile->png.empty() && entry != index.end() && entry->second.tile == tile)
+            {
+                order.erase(entry->second.position);
+                index.erase(entry);
+            }
+            lock.unlock();
+            rendered.notify_all();
+            return tile;
+        }
+
+    private:
+        struct Entry
+        {
+            std::list<TileKey>::iterator position;
+            std::shared_ptr<CachedTile> tile;
+        };
+
+        std::size_t capacity;
+        std::mutex mutex;
+        std::condition_variable rendered;
+
+        // Most recently used first
+        std::list<TileKey> order;
+        std::unordered_map<TileKey, Entry, TileKeyHash> index;
+    };
+
+    // Command line options
+    struct Options
+    {
+        unsigned short port = 8080;
+        std::size_t threads = ThreadPool::default_thread_count();
+        std::size_t cache_tiles = 4096;
+        std::string projection = AzimuthalEquidistant::name();
+        unsigned tile_size = 256;
+        unsigned max_zoom = 12;
+        double sun_step = 0.1;
+    };
+
+    // Parsed `GET /<z>/<x>/<y>.png[?time=...]`
+    struct TileRequest
+    {
+        unsigned z = 0;
+        unsigned x = 0;
+        unsigned y = 0;
+        bool has_time = false;
+        std::int64_t time = 0;
+    };
+
+    // Unsigned decimal number at `text[at]`, advancing `at` past it
+    bool parse_unsigned(const std::string &text, std::size_t &at, unsigned &value)
+    {
+        const auto begin = at;
+        value = 0;
+        while (at < text.size() && at - begin < 9 && text[at] >= '0' && text[at] <= '9')
+        {
+            value = value * 10 + static_cast<unsigned>(text[at++] - '0');
+        }
+        return at != begin;
+    }
+
+    bool parse_target(const std::string &target, TileRequest &request)
+    {
+        std::size_t at = 0;
+        const auto expect = [&](char c) { return at < target.size() && target[at++] == c; };
+        if (!expect('/') || !parse_unsigned(target, at, request.z) || !expect('/') || !parse_unsigned(target, at, request.x) || !expect('/') ||
+            !parse_unsigned(target, at, request.y) || target.compare(at, 4, ".png") != 0)
+        {
+            return false;
+        }
+        at += 4;
+
+        if (at == target.size())
+        {
+            return true;
+        }
+        const std::string time_parameter = "?time=";
+        if (target.compare(at, time_parameter.size(), time_parameter) != 0)
+        {
+            return false;
+        }
+        request.has_time = parse_utc(target.substr(at + time_parameter.size()), request.time);
+        return request.has_time;
+    }
+
+    // Request line and headers, up to the blank line ending them
+    //
+    // The whole request has to arrive within `request_timeout`, so that
+    // clients sending nothing or trickling bytes can't hold on to a handler.
+    bool receive_request(sf::TcpSocket &socket, std::string &request)
+    {
+        sf::SocketSelector selector;
+        selector.add(socket);
+        sf::Clock clock;
+
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos)
+        {
+            const auto remaining = request_timeout - clock.getElapsedTime();
+            if (request.size() > max_request_bytes || remaining <= sf::Time::Zero || !selector.wait(remaining))
+            {
+                return false;
+            }
+
+            std::size_t received = 0;
+            if (socket.receive(buffer, sizeof(buffer), received) != sf::Socket::Done)
+            {
+                return false;
+            }
+            request.append(buffer, received);
+        }
+        return true;
+    }
+
+    // Send all of `data` on a non-blocking socket, false if that fails or
+    // `clock` reaches `response_timeout` first. SocketSelector only waits
+    // for sockets to become readable, so a full send buffer is polled.
+    bool send_all(sf::TcpSocket &socket, const void *data, std::size_t size, const sf::Clock &clock)
+    {
+        const auto *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            std::size_t sent = 0;
+            const auto status = socket.send(bytes, size, sent);
+            if (status == sf::Socket::Done)
+            {
+                return true;
+            }
+            if ((status != sf::Socket::Partial && status != sf::Socket::NotReady) || clock.getElapsedTime() >= response_timeout)
+            {
+                return false;
+            }
+
+            bytes += sent;
+            size -= sent;
+            if (sent == 0)
+            {
+                sf::sleep(send_retry);
+            }
+        }
+        return true;
+    }
+
+    // `max_age` is how many seconds clients may reuse the response, 0 for not at all
+    //
+    // Like the request, the whole response has to go out within a timeout,
+    // so that clients that stop reading can't hold on to a handler, which
+    // then drops the connection.
+    void send_response(sf::TcpSocket &socket, const std::string &status, const std::string &content_type, const sf::Uint8 *body, std::size_t size, long max_age)
+    {
+        const auto cache_control = max_age > 0 ? "max-age=" + std::to_string(max_age) : std::string("no-store");
+        const auto header = "HTTP/1.1 " + status + "\r\n" + "Content-Type: " + content_type + "\r\n" + "Content-Length: " + std::to_string(size) + "\r\n" +
+                            "Cache-Control: " + cache_control + "\r\n" + "Access-Control-Allow-Origin: *\r\n" + "Connection: close\r\n\r\n";
+        socket.setBlocking(false);
+        sf::Clock clock;
+        if (send_all(socket, header.data(), header.size(), clock) && size > 0)
+        {
+            send_all(socket, body, size, clock);
+        }
+    }
+
+    void send_error(sf::TcpSocket &socket, const std::string &status)
+    {
+        const auto body = status + "\n";
+        send_response(socket, status, "text/plain", reinterpret_cast<const sf::Uint8 *>(body.data()), body.size(), 0);
+    }
+
+    // Renders tiles into buffers kept from request to request
+    template <typename Projection>
+    class TileRenderer
+    {
+    public:
+        explicit TileRenderer(unsigned tile_size)
+            : tile_size(tile_size), serial(1)
+        {
+        }
+
+        // Shadow over tile `x`, `y` of zoom level `z` with the sun over `sun`, as a PNG
+        void render(unsigned z, unsigned x, unsigned y, const LatLon &sun, std::vector<sf::Uint8> &png)
+        {
+            // One texel per tile of a grid over the whole map at this zoom,
+            // built only for the part this tile covers
+            const auto size = static_cast<float>(tile_size) * static_cast<float>(1u << z);
+            const auto x0 = static_cast<int>(x * tile_size);
+            const auto y0 = static_cast<int>(y * tile_size);
+            const auto side = static_cast<int>(tile_size);
+            grid.build<Projection>(size, 1.f, TileGrid::TileRect{x0, y0, x0 + side, y0 + side});
+            grid.shade(sun, cutoffs, shade, serial);
+
+            // Shadows are black, only the opacity follows the shade, and
+            // everything off the map stays transparent
+            pixels.assign(static_cast<std::size_t>(tile_size) * tile_size * 4, 0);
+            for (std::size_t i = 0; i < grid.count(); ++i)
+            {
+                const auto tx = static_cast<std::size_t>(std::lround(grid.x[i]) - x0);
+                const auto ty = static_cast<std::size_t>(std::lround(grid.y[i]) - y0);
+                pixels[(ty * tile_size + tx) * 4 + 3] = static_cast<sf::Uint8>(shade[i] * night_alpha / 255);
+            }
+
+            image.create(tile_size, tile_size, pixels.data());
+            if (!image.saveToMemory(png, "png"))
+            {
+                png.clear();
+            }
+        }
+
+    private:
+        unsigned tile_size;
+        IlluminationCutoffs cutoffs = IlluminationCutoffs::standard();
+
+        // Tiles are small, so requests are spread over threads rather than
+        // the rows of a tile
+        ThreadPool serial;
+
+        TileGrid grid;
+        std::vector<std::uint8_t> shade;
+        std::vector<sf::Uint8> pixels;
+        sf::Image image;
+    };
+
+    // Answer the request on `socket`, one per connection
+    template <typename Projection>
+    void handle(sf::TcpSocket &socket, const Options &options, TileCache &cache, TileRenderer<Projection> &renderer)
+    {
+        std::string request;
+        if (!receive_request(socket, request))
+        {
+            return;
+        }
+
+        // "GET <target> HTTP/1.x"
+        const auto method_end = request.find(' ');
+        const auto target_end = request.find(' ', method_end + 1);
+        if (method_end == std::string::npos || target_end == std::string::npos)
+        {
+            send_error(socket, "400 Bad Request");
+            return;
+        }
+        if (request.compare(0, method_end, "GET") != 0)
+        {
+            send_error(socket, "405 Method Not Allowed");
+            return;
+        }
+
+        TileRequest tile;
+        if (!parse_target(request.substr(method_end + 1, target_end - method_end - 1), tile) || tile.z > options.max_zoom || tile.x >= 1u << tile.z ||
+            tile.y >= 1u << tile.z)
+        {
+            send_error(socket, "404 Not Found");
+            return;
+        }
+
+        // Rendered at the rounded position, so the tile is exactly what the key says
+        const auto time = tile.has_time ? tile.time : static_cast<std::int64_t>(std::time(nullptr));
+        const auto sun = subsolar_point(static_cast<double>(time));
+        const auto key = TileKey{
+            static_cast<int>(std::lround(sun.lat / options.sun_step)),
+            static_cast<int>(std::lround(sun.lon / options.sun_step)),
+            tile.z,
+            tile.x,
+            tile.y,
+        };
+        const auto rounded = LatLon{static_cast<float>(key.sun_lat * options.sun_step), static_cast<float>(key.sun_lon * options.sun_step)};
+
+        const auto png = cache.get(key, [&](std::vector<sf::Uint8> &out) { renderer.render(tile.z, tile.x, tile.y, rounded, out); });
+        if (png->png.empty())
+        {
+            send_error(socket, "500 Internal Server Error");
+            return;
+        }
+        // Tiles for a time never change, those for now only until the sun
+        // moves on by a step, at 0.25° of longitude a minute
+        const auto max_age = tile.has_time ? 86400l : std::max(1l, static_cast<long>(options.sun_step * 240.));
+        send_response(socket, "200 OK", "image/png", png->png.data(), png->png.size(), max_age);
+    }
+
+    template <typename Projection>
+    int serve(const Options &options)
+    {
+        sf::TcpListener listener;
+        if (listener.listen(options.port) != sf::Socket::Done)
+        {
+            std::cerr << "Can't listen on port " << options.port << std::endl;
+            return 1;
+        }
+
+        TileCache cache(options.cache_tiles);
+        Channel<std::unique_ptr<sf::TcpSocket>> connections;
+        std::vector<std::thread> handlers;
+        for (std::size_t t = 0; t < options.threads; ++t)
+        {
+            handlers.emplace_back([&] {
+                TileRenderer<Projection> renderer(options.tile_size);
+                std::unique_ptr<sf::TcpSocket> socket;
+                while (true)
+                {
+                    connections.pop(socket);
+                    handle(*socket, options, cache, renderer);
+                    socket->disconnect();
+                }
+            });
+        }
+
+        std::cout << "Serving " << Projection::name() << " tiles on port " << options.port << " with " << options.threads << " threads" << std::endl;
+        while (true)
+        {
+            auto socket = std::make_unique<sf::TcpSocket>();
+            if (listener.accept(*socket) == sf::Socket::Done)
+            {
+                connections.push(std::move(socket));
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    auto valid = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto has_value = i + 1 < argc;
+        if (arg == "--port" && has_value)
+        {
+            options.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--cache-tiles" && has_value)
+        {
+            options.cache_tiles = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--projection" && has_value)
+        {
+            options.projection = argv[++i];
+        }
+        else if (arg == "--tile-size" && has_value)
+        {
+            options.tile_size = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-zoom" && has_value)
+        {
+            options.max_zoom = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--sun-step" && has_value)
+        {
+            options.sun_step = std::strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    // Tile coordinates past zoom 16 at 256 pixels no longer fit the float map coordinates of a TileGrid
+    if (!valid || options.port == 0 || options.threads == 0 || options.tile_size == 0 || options.max_zoom > 24 ||
+        (static_cast<std::uint64_t>(options.tile_size) << options.max_zoom) > (1u << 24) || !(options.sun_step > 0.))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--port N] [--threads N] [--cache-tiles N] [--projection " << projection_names() << "]\n"
+                  << "    [--tile-size PX] [--max-zoom Z] [--sun-step DEGREES]" << std::endl;
+        return 1;
+    }
+
+    auto result = 0;
+    if (!with_projection(options.projection, [&](auto projection) { result = serve<decltype(projection)>(options); }))
+    {
+        std::cerr << "Unknown projection " << options.projection << ", use one of " << projection_names() << std::endl;
+        return 1;
+    }
+    return result;
+}